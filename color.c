@@ -1,6 +1,10 @@
-#include <xc.h>
 #include "color.h"
 #include "i2c.h"
+#include "timers.h"
+#include "record.h"
+#include "lights.h"
+#include "power.h"
+#include <math.h>
 
 /************************************
  * Function to perform the initialization of the color click
@@ -18,13 +22,13 @@ void color_click_init(void)
 
      //set device PON
 	color_writetoaddr(0x00, 0x01);
-    __delay_ms(3); //need to wait 3ms for everthing to start up
+    HAL_DELAY_MS(3); //need to wait 3ms for everthing to start up
     
     //turn on device ADC
 	color_writetoaddr(0x00, 0x03);
 
-    //set integration time
-	color_writetoaddr(0x01, 0xD5);
+    //set integration time, COLOR_SAMPLE_MS
+	color_writetoaddr(0x01, COLOR_ATIME);
 }
 
 /************************************
@@ -73,19 +77,122 @@ void color_read_RGB(struct RGB_val *rgb)
     I2C_2_Master_Stop();          //Stop condition
 }
 
+/************************************
+ * Function to read one register of the color click
+ * Inputs: Register address
+ * Outputs: Register value
+ * Functions called within: The I2C functions, as in color_read_RGB() for a single byte
+************************************/
+static unsigned char color_readfromaddr(char address)
+{
+    unsigned char value;
+    I2C_2_Master_Start();         //Start condition
+    I2C_2_Master_Write(0x52 | 0x00);     //7 bit address + Write mode
+    I2C_2_Master_Write(0x80 | address);    //command + register address
+    I2C_2_Master_RepStart();			// start a repeated transmission
+    I2C_2_Master_Write(0x52 | 0x01);     //7 bit address + Read (1) mode
+    value = I2C_2_Master_Read(0);        //read the register (don't acknowledge, single read)
+    I2C_2_Master_Stop();          //Stop condition
+    return value;
+}
+
+/************************************
+ * Function to switch the RGB LED and start an integration under the new light
+ * Inputs: State of the red, green and blue LED
+ * Outputs: None
+ * Functions called within: lights_set() switches the LEDs on the next tick, then the ADC is switched off 
+ * and on again (AEN) so the integration restarts with none of the previous light in it. The other enable
+ * bits, e.g. the clear light interrupt, are kept.
+************************************/
+static void color_frame_start(char red, char green, char blue)
+{
+    unsigned char enable;
+    lights_set(LIGHT_RED, red);
+    lights_set(LIGHT_GREEN, green);
+    lights_set(LIGHT_BLUE, blue);
+    power_wait_ms(1); // The LowISR tick writes the LED pins
+    enable = color_readfromaddr(0x00);
+    color_writetoaddr(0x00, enable & ~0x02); // AEN off, stops the integration
+    color_writetoaddr(0x00, enable | 0x02); // ADC on, the integration starts again
+}
+
+/************************************
+ * Function to wait for the end of the integration started by color_frame_start()
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: power_wait_ms() idles through the integration, then the status register is 
+ * polled for AVALID for at most COLOR_VALID_MS
+************************************/
+static void color_frame_wait(void)
+{
+    char i;
+    power_wait_ms(COLOR_SAMPLE_MS);
+    for(i = 0; i < COLOR_VALID_MS && !(color_readfromaddr(0x13) & 0x01); i++){power_wait_ms(1);}
+}
+
+/************************************
+ * Function to read a card one LED colour at a time, for a reflectance that does not depend on the ambient light
+ * Inputs: RGB_val structure and pointer rgb for the result
+ * Outputs: None, rgb holds the red channel under the red LED, the green channel under the green LED and the 
+ * blue channel under the blue LED, each less the ambient frame, and C the sum of the clear channel of the 
+ * three LED frames less three ambient frames. calibrate_spectral() calibrates it, and it then takes the place
+ * of a mixed read, so the classifier sees the same three channels.
+ * Functions called within: color_frame_start(), color_frame_wait() and color_read_RGB() for an ambient frame with
+ * the LED off and a frame for each LED colour. Each frame is read while the LED switches for the next one, so a
+ * read takes four integrations and about 1ms per LED switch. The LED is left fully on for the colour stream.
+************************************/
+void color_read_spectral(struct RGB_val *rgb)
+{
+    struct RGB_val ambient, frame;
+    
+    color_frame_start(0, 0, 0);
+    color_frame_wait();
+    color_frame_start(1, 0, 0);
+    color_read_RGB(&ambient); // Latched ambient frame, the registers only change at the end of the next integration
+    color_frame_wait();
+    color_frame_start(0, 1, 0);
+    color_read_RGB(&frame);
+    rgb->R = (frame.R > ambient.R) ? frame.R - ambient.R : 0;
+    rgb->C = (frame.C > ambient.C) ? frame.C - ambient.C : 0;
+    color_frame_wait();
+    color_frame_start(0, 0, 1);
+    color_read_RGB(&frame);
+    rgb->G = (frame.G > ambient.G) ? frame.G - ambient.G : 0;
+    rgb->C += (frame.C > ambient.C) ? frame.C - ambient.C : 0;
+    color_frame_wait();
+    color_frame_start(1, 1, 1);
+    color_read_RGB(&frame);
+    rgb->B = (frame.B > ambient.B) ? frame.B - ambient.B : 0;
+    rgb->C += (frame.C > ambient.C) ? frame.C - ambient.C : 0;
+}
+
 /************************************
  * Function to convert the values read from the color_click sensors to RGB values ranging (0-255). 
  * red, green, and blue calibration measurements for Black RGB(0,0,0) and white RGB(255,255,255) are interpolated 
  * in between to obtain the 'normalized' RGB values for each color. 
- * Inputs: RGB_val structure and pointer rgb
+ * Inputs: RGB_val structure and pointer rgb with the raw counts, RGB_norm structure and pointer n for the result
  * Outputs: None
  * Functions called within: None
 ************************************/
-void calibrate_RGB(struct RGB_val *rgb)
+void calibrate_RGB(struct RGB_val *rgb, struct RGB_norm *n)
 {
-    rgb->R = 0 + ((rgb->R - rgb->B_R) * (255 - 0) / (rgb->W_R - rgb->B_R)); // Linear interpolation to calibrate R value to conventional 0,255 RGB scale
-    rgb->G = 0 + ((rgb->G - rgb->B_G) * (255 - 0) / (rgb->W_G - rgb->B_G)); // Linear interpolation to calibrate G value to conventional 0,255 RGB scale
-    rgb->B = 0 + ((rgb->B - rgb->B_B) * (255 - 0) / (rgb->W_B - rgb->B_B)); // Linear interpolation to calibrate B value to conventional 0,255 RGB scale
+    n->R = 0 + (((float)rgb->R - CAL_BLACK_R) * (255 - 0) / (CAL_WHITE_R - CAL_BLACK_R)); // Linear interpolation to calibrate R value to conventional 0,255 RGB scale
+    n->G = 0 + (((float)rgb->G - CAL_BLACK_G) * (255 - 0) / (CAL_WHITE_G - CAL_BLACK_G)); // Linear interpolation to calibrate G value to conventional 0,255 RGB scale
+    n->B = 0 + (((float)rgb->B - CAL_BLACK_B) * (255 - 0) / (CAL_WHITE_B - CAL_BLACK_B)); // Linear interpolation to calibrate B value to conventional 0,255 RGB scale
+}
+
+/************************************
+ * Function to convert a read of color_read_spectral() to RGB values ranging (0-255), as calibrate_RGB() 
+ * with the black and white calibration of the spectral read
+ * Inputs: RGB_val structure and pointer rgb from color_read_spectral(), RGB_norm structure and pointer n for the result
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void calibrate_spectral(struct RGB_val *rgb, struct RGB_norm *n)
+{
+    n->R = ((float)rgb->R - CAL_SPECTRAL_BLACK_R) * 255 / (CAL_SPECTRAL_WHITE_R - CAL_SPECTRAL_BLACK_R);
+    n->G = ((float)rgb->G - CAL_SPECTRAL_BLACK_G) * 255 / (CAL_SPECTRAL_WHITE_G - CAL_SPECTRAL_BLACK_G);
+    n->B = ((float)rgb->B - CAL_SPECTRAL_BLACK_B) * 255 / (CAL_SPECTRAL_WHITE_B - CAL_SPECTRAL_BLACK_B);
 }
 
 
@@ -93,38 +200,151 @@ void calibrate_RGB(struct RGB_val *rgb)
  * Function to convert the normalized RGB values to Hue. 
  * Associates a hue value from 0 to 360 to each color.
  * Hue value is calculated using predefined equations
- * Inputs: RGB_val structure and pointer rgb
+ * Inputs: RGB_norm structure and pointer n filled by calibrate_RGB()
  * Outputs: None
  * Functions called within: None
 ************************************/
-void RGB_to_Hue(struct RGB_val *rgb)
+void RGB_to_Hue(struct RGB_norm *n)
 {// Different hue equations depending on if R,G or B max
     
-    if(rgb->R >= rgb->G && rgb->R >= rgb->B){ // If R largest return R
-        rgb->max = rgb->R;
-    }else if(rgb->G >= rgb->R && rgb->G >= rgb->B){ // If G largest return G 
-        rgb->max = rgb->G;
+    if(n->R >= n->G && n->R >= n->B){ // If R largest return R
+        n->max = n->R;
+    }else if(n->G >= n->R && n->G >= n->B){ // If G largest return G 
+        n->max = n->G;
     }else{ // Else return B
-       rgb->max = rgb->B;
+       n->max = n->B;
     }
     
-    if(rgb->R <= rgb->G && rgb->R <= rgb->B){ // If R smallest return R
-        rgb->min = rgb->R;
-    }else if(rgb->G <= rgb->R && rgb->G <= rgb->B){ // If G smallest return G 
-        rgb->min = rgb->G;
+    if(n->R <= n->G && n->R <= n->B){ // If R smallest return R
+        n->min = n->R;
+    }else if(n->G <= n->R && n->G <= n->B){ // If G smallest return G 
+        n->min = n->G;
     }else{ // Else return B
-        rgb->min = rgb->B;
+        n->min = n->B;
     }
     
-    if(rgb->max == rgb->R){ // For R max
-        rgb->hue = ((rgb->G - rgb->B) / (rgb->max-rgb->min)) * 60;
-    }else if(rgb->max == rgb->G){ // For G max
-        rgb->hue = (2 + ((rgb->B - rgb->R) / (rgb->max-rgb->min))) * 60;
+    if(n->max == n->min){ // Grey, no hue
+        n->hue = 0;
+    }else if(n->max == n->R){ // For R max
+        n->hue = ((n->G - n->B) / (n->max-n->min)) * 60;
+    }else if(n->max == n->G){ // For G max
+        n->hue = (2 + ((n->B - n->R) / (n->max-n->min))) * 60;
     }else{ // For B max
-        rgb->hue = (4 + ((rgb->R - rgb->G) / (rgb->max-rgb->min))) * 60;
+        n->hue = (4 + ((n->R - n->G) / (n->max-n->min))) * 60;
     }
     
-    if(rgb->hue < 0){ // Conversion for hue if negative number
-        rgb->hue = 360 + rgb->hue; // Add another cycle to make it positive
+    if(n->hue < 0){ // Conversion for hue if negative number
+        n->hue = 360 + n->hue; // Add another cycle to make it positive
     }
 }
+
+
+/************************************
+ * Function to identify the card in front of the buggy from the calibrated RGB and hue values
+ * Inputs: RGB_norm structure and pointer n, after calibrate_RGB() and RGB_to_Hue()
+ * Outputs: Card code, 'R' red, 'G' green, 'B' blue, 'Y' yellow, 'P' pink, 'O' orange, 
+ * 'b' light blue, 'W' white and 'K' for black or an unidentified colour
+ * Functions called within: None
+************************************/
+char classify_RGB(struct RGB_norm *n)
+{
+    if(n->max - n->min < CLASS_GREY_SPREAD) //if white or light blue is registered...
+    {
+        if(n->hue > CLASS_WHITE_HUE_ABOVE || n->hue < CLASS_WHITE_HUE_BELOW){return 'W';} // if white is registered...
+        return 'b';                                       //if light blue is registered...
+    }
+    if(CLASS_RED_HUE<=n->hue && n->hue<=360)   //if pink/red/orange is registered...
+    {
+        if(n->G > CLASS_PINK_GB && n->B > CLASS_PINK_GB){return 'P';}  // If pink is registered...
+        if(n->R > CLASS_RED_R && n->G<CLASS_RED_G){return 'R';}   //if red is registered...
+        return 'O';                                  //If orange is registered
+    }
+    if(CLASS_GREEN_HUE_LO<=n->hue && n->hue<=CLASS_GREEN_HUE_HI){return 'G';}  //If green is registered...
+    if(CLASS_BLUE_HUE_LO<=n->hue && n->hue<=CLASS_BLUE_HUE_HI){return 'B';}  //If blue is registered...
+    if(0<=n->hue && n->hue<=CLASS_YELLOW_HUE){return 'Y';}     // If yellow is registered...
+    return 'K'; // If black is detected or unidentified colour
+}
+
+
+/************************************
+ * Function to sample the colour click while driving, at most once per integration period, and
+ * to keep a rolling classification of the samples close enough to the card to be classified
+ * Inputs: RGB_val structure and pointer rgb, Color_stream structure and pointer s
+ * Outputs: 1 if a new sample was taken (rgb->C holds its clear level), 0 otherwise
+ * Functions called within: color_read_RGB() reads the sample, from whose clear level the range to the card
+ * and its rate of change are updated for the braking controller. The sample is then calibrated, converted to 
+ * hue and classified with calibrate_RGB(), RGB_to_Hue() and classify_RGB() once the clear level 
+ * reaches COLOR_STREAM_C. The card is recognised once s->count reaches COLOR_STREAM_AGREE. Only the 
+ * coloured cards, identified by hue, are recognised this way.
+************************************/
+char color_stream(struct RGB_val *rgb, struct Color_stream *s)
+{
+    char card;
+    struct RGB_norm n; // Calibrated values and hue of the sample
+    unsigned long now = get_ms();
+    float range;
+    if(now - s->last < COLOR_SAMPLE_MS){return 0;} // The sensor has no new integration yet
+    
+    color_read_RGB(rgb);
+    RECORD_READ(rgb, RECORD_STREAM);
+    range = 1 / sqrt((float)rgb->C + 1); // Reflected light falls off with the square of the distance, so this is linear in distance
+    if(s->range > 0) // Approach rate from the last two samples, averaged with the previous estimate against sensor noise
+    {
+        float rate = (range - s->range) / (float)(now - s->last);
+        s->rate = (s->rate == 0) ? rate : (s->rate + rate) / 2;
+    }
+    s->range = range;
+    s->last = now;
+    
+    if(rgb->C < COLOR_STREAM_C) // Too far away, the black and white calibration does not hold yet
+    {
+        s->card = 0;
+        s->count = 0;
+        return 1;
+    }
+    calibrate_RGB(rgb, &n);
+    RGB_to_Hue(&n);
+    card = classify_RGB(&n);
+    RECORD_DECIDE(card);
+    if(card == 'W' || card == 'b' || card == 'K') // Told apart by brightness, which only holds at the calibration distance
+    {
+        card = 0;   // Left to the clear light interrupt and a read at the calibration distance
+    }
+    if(card == s->card)
+    {
+        if(s->count < COLOR_STREAM_AGREE){s->count++;}
+    }
+    else
+    {
+        s->card = card; // A different colour, start counting again
+        s->count = 1;
+    }
+    return 1;
+}
+
+/************************************
+ * Function to forget the rolling classification, e.g. after the card has been handled
+ * Inputs: Color_stream structure and pointer s
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void color_stream_reset(struct Color_stream *s)
+{
+    s->card = 0;
+    s->count = 0;
+    s->last = get_ms();
+    s->range = 0;   // The next sample starts a new approach rate estimate
+    s->rate = 0;
+}
+
+/************************************
+ * Function to decide whether a card recognised by the colour stream should be acted on now
+ * Inputs: Color_stream structure and pointer s, updated by color_stream()
+ * Outputs: 1 if the card is recognised and the stand-off is reached before the next sample is halfway, 0 otherwise
+ * Functions called within: None
+************************************/
+char color_stream_turn(struct Color_stream *s)
+{
+    if(s->card == 0 || s->count < COLOR_STREAM_AGREE){return 0;}
+    return (s->range + s->rate * (COLOR_SAMPLE_MS / 2) <= COLOR_TURN_RANGE); // Sample closest to the stand-off
+}
@@ -1,21 +1,42 @@
 #ifndef _color_H
 #define _color_H
 
-#include <xc.h>
+#include "hal.h"
 
-#define _XTAL_FREQ 64000000 //note intrinsic _delay function is 62.5ns at 64,000,000Hz  
 
 struct RGB_val //Defining the RGB value structure
 { 
-    //Variables to store integer values returned for each colour by color_read_RGB
-	float R, G, B, C, W_R, W_G, W_B, B_R, B_G, B_B, hue, max, min; //Read, Green, Blue, Clear then all the calibration values
+    //Raw counts returned for each colour by color_read_RGB, the black and white calibration is CAL_BLACK_x/CAL_WHITE_x of the robot profile
+	unsigned int R, G, B, C; //Red, Green, Blue, Clear
+};
+
+struct RGB_norm //Values derived from a read by calibrate_RGB() and RGB_to_Hue(), only kept on the stack while classifying
+{
+    float R, G, B, hue, max, min; //Calibrated Red, Green, Blue (0-255), hue (0-360) and the largest and smallest of R, G, B
+};
+
+// Integration time (COLOR_SAMPLE_MS), stream thresholds and classification bands are set in the robot profile (robot_config.h)
+#define COLOR_VALID_MS  5   // Longest wait for the end of an integration after COLOR_SAMPLE_MS in color_read_spectral()
+
+struct Color_stream { //Rolling classification of the samples taken while driving
+    char card;              // Card code of the last classified sample, 0 if it was too far to classify
+    char count;             // Number of consecutive samples that agreed on card
+    unsigned long last;     // ms tick of the last sample
+    float range;            // 1/sqrt(C) of the last sample, proportional to the distance to the card (inverse square fall off), 0 if unknown
+    float rate;             // Change of range per ms, averaged over the last samples, negative while approaching, 0 if unknown
 };
 
 //function prototypes (Function descriptions are to be found in the .c file)
 void color_click_init(void);
 void color_writetoaddr(char address, char value);
 void color_read_RGB(struct RGB_val *rgb);
-void calibrate_RGB(struct RGB_val *rgb);
-void RGB_to_Hue(struct RGB_val *rgb);
+void color_read_spectral(struct RGB_val *rgb);
+void calibrate_RGB(struct RGB_val *rgb, struct RGB_norm *n);
+void calibrate_spectral(struct RGB_val *rgb, struct RGB_norm *n);
+void RGB_to_Hue(struct RGB_norm *n);
+char classify_RGB(struct RGB_norm *n);
+char color_stream(struct RGB_val *rgb, struct Color_stream *s);
+void color_stream_reset(struct Color_stream *s);
+char color_stream_turn(struct Color_stream *s);
 
 #endif
\ No newline at end of file
@@ -1,12 +1,25 @@
-#include <xc.h>
+#include "hal.h"
 #include "dc_motor.h"
+#include "lights.h"
+#include "serial.h"
+#include "timers.h"
+#include "power.h"
+#include "motion.h"
+#include "turncal.h"
+#include "perf.h"
+#include "supervisor.h"
 #include "string.h"
+#include <stdio.h>
+#include <math.h>
 
-#define turn90left 55 //Define the delay time for a 90 degree left turn
-#define turn90right 40 //Define the delay time for a 90 degree right turn
-#define turn180left 270 //Define the delay time for a 180 degree left turn
-#define turn135right 120 //Define the delay time for a 135 degree right turn
-#define turn135left 120 //Define the delay time for a 135 degree left turn
+// Wheel speed at 0, 10, ... 100% power in % of the speed at full power, measured by turncal_speed() and loaded by
+// motorSpeedLoad(). Until then the speed_table of the robot profile, a model placeholder: the linear model of the
+// simulator with its 30% deadband.
+static unsigned char speed_table[11] = SPEED_TABLE;
+
+static long odometer = 0;           // Distance driven forwards, ms x % of full speed, integrated at every power change
+static unsigned long odo_ms = 0;    // ms tick up to which the odometer has been integrated
+static int odo_speed = 0;           // Sum of both wheel speeds since then, % of full speed
 
 /************************************
  * Function to initialise Timer2 and PWM for DC motor control
@@ -15,58 +28,62 @@
  * Functions called within: None
 ************************************/
 void initDCmotorsPWM(int PWMperiod){
-	//initialise your TRIS and LAT registers for PWM
-    TRISEbits.TRISE4 = 0; 
-    TRISGbits.TRISG6 = 0; 
-    TRISCbits.TRISC7 = 0;
-    TRISEbits.TRISE2 = 0;
-  
-    LATEbits.LATE4 = 0;
-    LATGbits.LATG6 = 0;
-    LATEbits.LATE2 = 0;
-    LATCbits.LATC7 = 0;
-
-    
-    // timer 2 config
-    T2CONbits.CKPS=0b0011; // 1:8 prescaler. Calculated 6.22 but taking larger prescaler for longer overflow.
-    T2HLTbits.MODE=0b00000; // Free Running Mode, software gate only
-    T2CLKCONbits.CS=0b0001; // Fosc/4
+    hal_pwm_init(PWMperiod); // Configure Timer2, PWM6/7 and the direction pins
+}
 
-    // Tpwm*(Fosc/4)/prescaler - 1 = PTPER
-    T2PR= PWMperiod; //Period reg 10kHz base period. Calculated with a PS = 8. Timer2 count required for overflow. (was 199 bef changed to PWMperiod))
-    T2CONbits.ON=1;
-    
-    RE2PPS=0x0A; //PWM6 on RE2
-    RC7PPS=0x0B; //PMW7 on RC7
+/************************************
+ * Function returning the PWM duty for the motor's power, interpolated from its calibrated curve
+ * Inputs: DC_motor structure and pointer "m"
+ * Outputs: Duty in % of the PWM period
+ * Functions called within: None
+************************************/
+static unsigned char motorDuty(struct DC_motor *m)
+{
+    unsigned char i = m->power / 10;
+    if(i >= 10){return m->curve[10];}
+    return m->curve[i] + ((m->curve[i + 1] - m->curve[i]) * (m->power - i * 10)) / 10;
+}
 
-    PWM6DCH=0; //0% power. Send frac value out of 199 for %.
-    PWM7DCH=0; //0% power. Send frac value out of 199 for %.
-    
-    PWM6CONbits.EN = 1;
-    PWM7CONbits.EN = 1;
+/************************************
+ * Function returning the odometer, called with the tick interrupt held off or from LowISR
+ * Inputs: None
+ * Outputs: As odometerRead()
+ * Functions called within: None
+************************************/
+static long odometerNow(void)
+{
+    return odometer + ((long)(get_ms() - odo_ms) * odo_speed) / 2;
 }
 
 /************************************
- * Function to set PWM output from the values in the motor structure 
- * and thus control motor power and movement
+ * Function to set PWM output from the values in the motor structure, called from LowISR by motion_tick()
  * Inputs: DC_motor structure and pointer "m"
  * Outputs: None
- * Functions called within: None
+ * Functions called within: motorDuty() maps the power through the motor's curve, odometerNow() and 
+ * motorSpeed() keep the odometer up to date with the new speed, all integer so it is short enough for the ISR
 ************************************/
-void setMotorPWM(struct DC_motor *m)
+void setMotorPWMTick(struct DC_motor *m)
 {
 	int PWMduty; //tmp variable to store PWM duty cycle
+    int duty = motorDuty(m); //trimmed power
 
 	if (m->direction){ //if forward
 		// low time increases with power
-		PWMduty=m->PWMperiod - ((int)(m->power)*(m->PWMperiod))/100;
+		PWMduty=m->PWMperiod - (duty*(m->PWMperiod))/100;
 	}
 	else { //if reverse
 		// high time increases with power 
-		PWMduty=((int)(m->power)*(m->PWMperiod))/100;
+		PWMduty=(duty*(m->PWMperiod))/100;
 	}
 
 	*(m->dutyHighByte) = PWMduty; //set high duty cycle byte 
+    
+    // Integrate the distance driven at the old speed before changing it
+    odometer = odometerNow();
+    odo_ms = get_ms();
+    odo_speed = odo_speed - m->speed;
+    m->speed = m->direction ? -motorSpeed(m->power) : motorSpeed(m->power); // Direction low drives forwards
+    odo_speed = odo_speed + m->speed;
         
 	if (m->direction){ // if direction is high
 		*(m->dir_LAT) = *(m->dir_LAT) | (1<<(m->dir_pin)); // set dir_pin bit in LAT to high without changing other bits
@@ -76,84 +93,203 @@ void setMotorPWM(struct DC_motor *m)
 }
 
 /************************************
- * Function to stop the DC Motor gradually
+ * Function to set PWM output from the values in the motor structure 
+ * and thus control motor power and movement
+ * Inputs: DC_motor structure and pointer "m"
+ * Outputs: None
+ * Functions called within: setMotorPWMTick() with interrupts disabled, as the tick of a motion primitive also
+ * changes the motors and the odometer
+************************************/
+void setMotorPWM(struct DC_motor *m)
+{
+    HAL_INTERRUPTS(0);
+    setMotorPWMTick(m);
+    HAL_INTERRUPTS(1);
+}
+
+/************************************
+ * Function to stop the DC Motor gradually, with the brake light on, and to end the turn indicators
  * Inputs: DC_motor structure and pointer for the left motor and the right motor.
  * Outputs: None
  * Functions called within: The function to set PWM output from the values in the motor structure is called
 ************************************/
 void stop(struct DC_motor *mL, struct DC_motor *mR)
 {
+    unsigned char task = supervisor_require(SUP_MOTION); // The ramp has at most 100 steps
+    if((mL->power != 0) || (mR->power != 0)) // Moving
+    {
+        lights_set(LIGHT_BRAKE, 1); // Brake light while slowing down
+        perf.stops++;
+        perf_phase(PERF_RAMP);
+    }
     while(((mL->power) != 0) || ((mR->power) != 0)) // While power is not 0
     {
+        supervisor_checkin(SUP_MOTION);
         if (mL->power>0) {mL->power--;} // Decrement left motor power by 1
         if (mR->power>0) {mR->power--;} // Decrement right motor power by 1
         setMotorPWM(mL); // Apply power changes to left motor
         setMotorPWM(mR); // Apply power changes to right motor
-        __delay_ms(5); // Execution time to allow for gradual change
+        power_wait_ms(RAMP_MS); // Execution time to allow for gradual change
     }
+    lights_set(LIGHT_BRAKE, 0);
+    lights_set(LIGHT_TURN_L, 0); // Any turn ends with a stop
+    lights_set(LIGHT_TURN_R, 0);
+    perf_phase(PERF_STAND);
+    supervisor_require(task);
 }
 
 /************************************
- * Function to make the buggy turn left abruptly (for better contorl)
- * Inputs: DC_motor structure and pointer for the left motor and the right motor.
+ * Function to make the buggy turn left abruptly (for better contorl) and stop
+ * Inputs: DC_motor structure and pointer for the left motor and the right motor, angle in degrees and
+ * time at full power in ms for that angle
  * Outputs: None
- * Functions called within: The function to set PWM output from the values in the motor structure is called
+ * Functions called within: motion_turn() stops the buggy and turns by the angle on the gyro, or at full
+ * power for exactly the given time on the 1ms tick and ramps down as stop() does when there is no gyro
 ************************************/
-void turnLeft(struct DC_motor *mL, struct DC_motor *mR)
+void turnLeft(struct DC_motor *mL, struct DC_motor *mR, int degrees, unsigned int ms)
 {
-    stop(mL,mR);
-    // Set turning direction to left
-    mL->direction = 1;
-    mR->direction = 0;
-    // Set full power for left turn
-    mL->power = 100;
-    mR->power = 100;
-    setMotorPWM(mL); // Apply power changes to left motor
-    setMotorPWM(mR); // Apply power changes to right motor
-    __delay_ms(10); // Execution time
+    motion_turn(mL,mR,MOTION_LEFT,degrees,ms);
 }
 
 /************************************
- * Function to make the buggy turn right abruptly (for better contorl)
- * Inputs: DC_motor structure and pointer for the left motor and the right motor.
+ * Function to make the buggy turn right abruptly (for better contorl) and stop
+ * Inputs: DC_motor structure and pointer for the left motor and the right motor, angle in degrees and
+ * time at full power in ms for that angle
  * Outputs: None
- * Functions called within: The function to set PWM output from the values in the motor structure is called
+ * Functions called within: motion_turn() as in turnLeft()
 ************************************/
-void turnRight(struct DC_motor *mL, struct DC_motor *mR)
+void turnRight(struct DC_motor *mL, struct DC_motor *mR, int degrees, unsigned int ms)
 {
-    stop(mL,mR);
-    // Set turning direction to right
-    mL->direction = 0;
-    mR->direction = 1;
-    // Set full power for right turn
-    mL->power = 100;
-    mR->power = 100;
-    setMotorPWM(mL); // Apply power changes to left motor
-    setMotorPWM(mR); // Apply power changes to right motor
-    __delay_ms(10); // Execution time
-   
-    
+    motion_turn(mL,mR,MOTION_RIGHT,degrees,ms);
 }
 
 /************************************
- * Function to make the buggy go forward 
- * Inputs: DC_motor structure and pointer for the left motor and the right motor.
+ * Function to make the buggy go forward at the given power, ramping up or down to it
+ * Inputs: DC_motor structure and pointer for the left motor and the right motor, forward power out of 100
  * Outputs: None
  * Functions called within: The function to set PWM output from the values in the motor structure is called
 ************************************/
-void fullSpeedAhead(struct DC_motor *mL, struct DC_motor *mR)
+void driveForward(struct DC_motor *mL, struct DC_motor *mR, char power)
 {
+    unsigned char task = supervisor_require(SUP_MOTION); // The ramp has at most 100 steps
     // Set direction to forward
     mL->direction = 0;
     mR->direction = 0;
-    while(mL->power<50 || mR->power<50) // While power is not 50, max forward power limit is 50
+    while(mL->power != power || mR->power != power) // While power is not at the requested level
     {
-        if (mL->power<50) {mL->power++;} // Increment left motor power by 1
-        if (mR->power<50) {mR->power++;} // Increment right motor power by 1
+        supervisor_checkin(SUP_MOTION);
+        perf_phase(PERF_RAMP);
+        if (mL->power<power) {mL->power++;} else if (mL->power>power) {mL->power--;} // Step left motor power by 1
+        if (mR->power<power) {mR->power++;} else if (mR->power>power) {mR->power--;} // Step right motor power by 1
     setMotorPWM(mL); // Apply power changes to left motor
     setMotorPWM(mR); // Apply power changes to right motor
-    __delay_ms(5); // Execution time to allow for gradual change
+    power_wait_ms(RAMP_MS); // Execution time to allow for gradual change
     }  
+    perf_phase(power ? PERF_FORWARD : PERF_STAND);
+    supervisor_require(task);
+}
+
+/************************************
+ * Braking controller, chooses the forward power from the approach rate measured by the colour stream
+ * The time until the stand-off is reached at the current rate sets the power, so the buggy decelerates 
+ * along a profile that reaches APPROACH_POWER BRAKE_LEAD_MS before the card is acted on.
+ * Inputs: Color_stream structure and pointer s, updated by color_stream()
+ * Outputs: Forward power out of 100, between APPROACH_POWER and CRUISE_POWER
+ * Functions called within: None
+************************************/
+char approachPower(struct Color_stream *s)
+{
+    float t_hit; // ms until the stand-off at the current approach rate
+    float power;
+    if(s->range == 0){return APPROACH_POWER;}             // No sample yet, e.g. just after a turn
+    if(s->range <= BRAKE_TARGET_RANGE){return APPROACH_POWER;} // Already at the stand-off
+    if(s->rate >= 0) // Not getting closer, cruise unless something is already near
+    {
+        if(s->range < BRAKE_APPROACH_RANGE){return APPROACH_POWER;}
+        return CRUISE_POWER;
+    }
+    t_hit = (s->range - BRAKE_TARGET_RANGE) / -s->rate;
+    power = APPROACH_POWER + (t_hit - BRAKE_LEAD_MS) / BRAKE_MS_PER_POWER;
+    if(power < APPROACH_POWER){return APPROACH_POWER;}
+    if(power > CRUISE_POWER){return CRUISE_POWER;}
+    return (char)power;
+}
+
+/************************************
+ * Function returning the wheel speed at a given power, interpolated from the speed calibration table
+ * Inputs: Power out of 100
+ * Outputs: Speed in % of the speed at full power
+ * Functions called within: None
+************************************/
+int motorSpeed(char power)
+{
+    unsigned char i = power / 10;
+    if(i >= 10){return speed_table[10];}
+    return speed_table[i] + ((speed_table[i + 1] - speed_table[i]) * (power - i * 10)) / 10;
+}
+
+/************************************
+ * Function returning the distance driven forwards since power up, dead reckoned from the wheel speeds
+ * Inputs: None
+ * Outputs: Distance in ms x % of full speed (divide by 100 for ms at full speed), turns on the spot add nothing
+ * Functions called within: odometerNow() with interrupts disabled, so a motion primitive cannot change the
+ * speed half way through the read
+************************************/
+long odometerRead(void)
+{
+    long d;
+    HAL_INTERRUPTS(0);
+    d = odometerNow();
+    HAL_INTERRUPTS(1);
+    return d;
+}
+
+/************************************
+ * Function returning the distance covered while ramping between standstill and a power, 
+ * one power step per RAMP_MS as in driveForward() and stop()
+ * Inputs: Power out of 100
+ * Outputs: Distance in ms x % of full speed
+ * Functions called within: motorSpeed()
+************************************/
+static long rampDistance(char power)
+{
+    long d = 0;
+    char p;
+    for(p = 1; p <= power; p++){d = d + RAMP_MS * motorSpeed(p);}
+    return d;
+}
+
+/************************************
+ * Function to drive one remembered leg, back in retrace() or forward in playback(), ending with the stop of the following turn
+ * Inputs: DC_motor structure and pointer for the left motor and the right motor, 
+ * distance of the leg in ms at full speed
+ * Outputs: None
+ * Functions called within: driveForward() ramps up to RETURN_POWER, or less if the leg is too short for both ramps
+ * but never into the deadband of the speed table,
+ * and the time at that power is the rest of the distance scaled by the speed ratio from the calibration table,
+ * run by motion_run() so the stop ramp starts on the exact tick.
+************************************/
+static void driveLeg(struct DC_motor *mL, struct DC_motor *mR, int distance)
+{
+    char power = RETURN_POWER;
+    long cruise;
+    if(distance <= 0){return;}
+    while(power > APPROACH_POWER && 2 * rampDistance(power) > (long)distance * 100){power = power - 10;}
+    while(motorSpeed(power) == 0 && power < 100){power++;} // Above the deadband of the speed table, the time at power divides by the speed
+    cruise = (long)distance * 100 - 2 * rampDistance(power); // The ramp up and the stop ramp cover the rest
+    driveForward(mL,mR,power);
+    motion_run(mL,mR,MOTION_FORWARD,power,cruise > 0 ? (unsigned int)(cruise / motorSpeed(power)) : 0);
+}
+
+/************************************
+ * Function to make the buggy go forward at the approach power
+ * Inputs: DC_motor structure and pointer for the left motor and the right motor.
+ * Outputs: None
+ * Functions called within: driveForward() is called with APPROACH_POWER
+************************************/
+void fullSpeedAhead(struct DC_motor *mL, struct DC_motor *mR)
+{
+    driveForward(mL,mR,APPROACH_POWER); // forward power limit for stopping room
 }
 
 /************************************
@@ -164,122 +300,312 @@ void fullSpeedAhead(struct DC_motor *mL, struct DC_motor *mR)
 ************************************/
 void fullSpeedBack(struct DC_motor *mL, struct DC_motor *mR)
 {
+    unsigned char task = supervisor_require(SUP_MOTION); // The ramp has at most BACK_POWER steps
     // Set direction to backwards
+    perf_phase(PERF_BACK);
     mL->direction = 1;
     mR->direction = 1;
-    while(mL->power<50 || mR->power<50){ // While power is not 50, max backward power limit is 50
-        if (mL->power<50) {mL->power++;} // Increment left motor power by 1
-        if (mR->power<50) {mR->power++;} // Increment right motor power by 1
+    while(mL->power<BACK_POWER || mR->power<BACK_POWER){ // While power is not at the backward power limit
+        supervisor_checkin(SUP_MOTION);
+        if (mL->power<BACK_POWER) {mL->power++;} // Increment left motor power by 1
+        if (mR->power<BACK_POWER) {mR->power++;} // Increment right motor power by 1
     setMotorPWM(mL); // Apply power changes to left motor
     setMotorPWM(mR); // Apply power changes to right motor
-    __delay_ms(10); // Execution time to allow for gradual change
+    power_wait_ms(BACK_RAMP_MS); // Execution time to allow for gradual change
     }  
+    supervisor_require(task);
 }
 
 /************************************
- * Function to make the buggy go retrace its steps
+ * Function to make the buggy go retrace its steps, driving the legs at RETURN_POWER
  * Inputs: The Memory structure and pointer m that can be used to access the memory 
- * array for the time driven forwards and the types of turns made. Also the DC motor structures and pointers as well
- * as the count for the steps made by the buggy. 
+ * array for the time driven forwards, the types of turns made and the step count of the buggy. Also the DC motor
+ * structures and pointers as well. 
  * Outputs: None
  * Functions called within: The function to execute the appropriate motor functions outlined above and 
  * to clear the path memory arrays
+ * Progress is kept in m->step and m->retracing, so a retrace interrupted by a reset resumes where it stopped
+ * (supervisor.h), a leg cut short is driven again in full.
 ************************************/
-void retrace(struct Memory *m,struct DC_motor *motorL, struct DC_motor *motorR, int step)
+void retrace(struct Memory *m,struct DC_motor *motorL, struct DC_motor *motorR)
 {      
-    LATHbits.LATH3 = 1;  //Turn on LED that signifies retrace
-    turnLeft(motorL,motorR); // Turn by 180 degrees
-    __delay_ms(turn180left);
-    stop(motorL,motorR); // Stop buggy
-    __delay_ms(500);
-    
-    //We trace back a distance driven once before we enter the while loop that follows, because there is one more
-    //distance driven compared to the number of turns.
-    while(m->time_forward[step]>0) // While the counter value recoded for the step is greater than 0
+    unsigned char task = supervisor_require(SUP_PATH); // Checks in once per leg and per turn
+    HAL_GPIO_WRITE(PIN_DEBUG, 1);  //Turn on LED that signifies retrace
+    HAL_PROBE(PROBE_RETRACE, 1);
+    if(m->retracing == RETRACE_OFF) // Not resuming after a reset
     {
-        fullSpeedAhead(motorL,motorR); // Driving full speed ahead
-        __delay_ms(12); //the same delay as in between the count increments in main
-        m->time_forward[step]--;
+        turnLeft(motorL,motorR,180,turn_ms[TURN_L180]); // Turn by 180 degrees
+        stop(motorL,motorR); // Stop buggy
+        //We trace back a distance driven once before the turns, because there is one more
+        //distance driven compared to the number of turns.
+        m->retracing = RETRACE_LEG;
     }
-    step--; // decrement the step to go through the memory arrays
             
-    while(step>=0)
+    while(m->step>=0)
     {
+        supervisor_checkin(SUP_PATH);
+        if(m->retracing == RETRACE_LEG) //Turn already undone
+        {
+            driveLeg(motorL,motorR,m->time_forward[m->step]);
+            m->step--; // decrement the step to go through the memory arrays
+            m->retracing = RETRACE_TURN;
+            continue;
+        }
         //Vary lights before every remembered turn, not used for measurement purposes, purely aesthetic!
-        LATGbits.LATG1 = 1; // Red LED
-        LATAbits.LATA4 = 0; // Green LED
-        LATFbits.LATF7 = 0; // Blue LED
-        __delay_ms(200);
-        LATGbits.LATG1 = 0; // Red LED
-        LATAbits.LATA4 = 1; // Green LED
-        LATFbits.LATF7 = 0; // Blue LED
-        __delay_ms(200);
-        LATGbits.LATG1 = 0; // Red LED
-        LATAbits.LATA4 = 0; // Green LED
-        LATFbits.LATF7 = 1; // Blue LED
-        __delay_ms(200);
-        LATGbits.LATG1 = 0; // Red LED
-        LATAbits.LATA4 = 0; // Green LED
-        LATFbits.LATF7 = 0; // Blue LED
-        
-        __delay_ms(200);
-        if(m->turn[step] == 'R') //If red remembered...
+        //The red, green, blue sequence plays in the background while the buggy turns, ending fully on for the colour click.
+        //The leg above already ends where the turn was made, it no longer rolls on while the lights play
+        lights_play(LIGHT_RED, 0b10001, 5, 200, LIGHT_HOLD);
+        lights_play(LIGHT_GREEN, 0b10010, 5, 200, LIGHT_HOLD);
+        lights_play(LIGHT_BLUE, 0b10100, 5, 200, LIGHT_HOLD);
+        if(m->turn[m->step] == 'R') //If red remembered...
         {
             //Undo a red turn
-            turnLeft(motorL,motorR); // Turn by 90 degrees to the left
-            __delay_ms(turn90left);
+            turnLeft(motorL,motorR,90,turn_ms[TURN_L90]); // Turn by 90 degrees to the left
         }
-        else if(m->turn[step] == 'G') //If green remembered...
+        else if(m->turn[m->step] == 'G') //If green remembered...
         {
             //undo a green turn
-            turnRight(motorL,motorR); // Turn by 90 degrees to the right
-            __delay_ms(turn90right);
+            turnRight(motorL,motorR,90,turn_ms[TURN_R90]); // Turn by 90 degrees to the right
         }
-        else if(m->turn[step] == 'B') //If blue remembered...
+        else if(m->turn[m->step] == 'B') //If blue remembered...
         {
             //undo a blue turn
-            turnLeft(motorL,motorR); // Turn by 90 degrees to the right
-            __delay_ms(turn180left);
+            turnLeft(motorL,motorR,180,turn_ms[TURN_L180]); // Turn by 180 degrees
         }
-        else if(m->turn[step] == 'Y') //If yellow remembered...
+        else if(m->turn[m->step] == 'Y') //If yellow remembered...
         {
             //undo a yellow turn
-            turnLeft(motorL,motorR);         // Turn by 90 degrees to the left
-            __delay_ms(turn90right);
+            turnLeft(motorL,motorR,90,turn_ms[TURN_L90]); // Turn by 90 degrees to the left
         }
-        else if(m->turn[step] == 'P') //If pink remembered...
+        else if(m->turn[m->step] == 'P') //If pink remembered...
         {
             //undo a pink turn
-            turnRight(motorL,motorR);     //Turn by 90 degrees to the right
-            __delay_ms(turn90left);
+            turnRight(motorL,motorR,90,turn_ms[TURN_R90]); //Turn by 90 degrees to the right
         }
-        else if(m->turn[step] == 'O') //If orange remembered...
+        else if(m->turn[m->step] == 'O') //If orange remembered...
         {
             //undo an orange turn
-            turnLeft(motorL,&motorR);     // Turn by 135 degrees to the left
-            __delay_ms(turn135left);
+            turnLeft(motorL,motorR,135,turn_ms[TURN_L135]); // Turn by 135 degrees to the left
         }
-        else if(m->turn[step] == 'b') //If blue remembered...
+        else if(m->turn[m->step] == 'b') //If blue remembered...
         {
             //undo a light blue turn
-            turnRight(motorL,motorR);     // Turn by 135 degrees to the right
-            __delay_ms(turn135right);
+            turnRight(motorL,motorR,135,turn_ms[TURN_R135]); // Turn by 135 degrees to the right
         }
         
         stop(motorL,motorR);
-        __delay_ms(500);
-        
-        //Drive back the remembered distance
-        while(m->time_forward[step]>0) // While the counter value recoded for the step is greater than 0
-        {
-            fullSpeedAhead(motorL,motorR); //Buggy will drive full speed ahead
-            __delay_ms(12); //the same delay as in between the count increments in main
-            m->time_forward[step]--;
-        }
-        step--; // we decrement the step to go through the memory arrays
+        m->retracing = RETRACE_LEG; //Drive back the remembered distance next
     }
+    stop(motorL,motorR); // The last leg ends at the start position
     //Clearing the memory arrays for a new path memory to be stored
     memset(m->time_forward, 0, sizeof(m->time_forward));
     memset(m->turn, 0, sizeof(m->turn));
-    LATHbits.LATH3 = 0;                 //Turn off LED that signifies retrace
-}
\ No newline at end of file
+    m->retracing = RETRACE_OFF;
+    HAL_GPIO_WRITE(PIN_DEBUG, 0);      //Turn off LED that signifies retrace
+    HAL_PROBE(PROBE_RETRACE, 0);
+    supervisor_require(task);
+}
+
+/************************************
+ * Function to make the turn of a card while driving a path forward
+ * Inputs: Turn code (PATH_TURNS), DC_motor structure and pointer for the left motor and the right motor
+ * Outputs: None
+ * Functions called within: The turn functions with the turn times of main.c. Pink and yellow do not back
+ * out of the dead end, as the path memory has the dead end cut off.
+************************************/
+static void turnCard(char code, struct DC_motor *mL, struct DC_motor *mR)
+{
+    if(code == 'b'){turnLeft(mL,mR,135,turn_ms[TURN_L135]);}
+    else if(code == 'P' || code == 'G'){turnLeft(mL,mR,90,turn_ms[TURN_L90]);}
+    else if(code == 'R' || code == 'Y'){turnRight(mL,mR,90,turn_ms[TURN_R90]);}
+    else if(code == 'O'){turnRight(mL,mR,135,turn_ms[TURN_R135]);}
+    else if(code == 'B'){turnLeft(mL,mR,180,turn_ms[TURN_L180]);}
+    stop(mL,mR);
+}
+
+/************************************
+ * Function to drive the path memory forward from the start, e.g. an uploaded mission, without reading cards
+ * Inputs: The Memory structure and pointer m with the legs and turns up to m->step, 
+ * DC_motor structure and pointer for the left motor and the right motor
+ * Outputs: None
+ * Functions called within: driveLeg() and turnCard(), the motion of retrace() in the other direction.
+ * m->step follows the leg being driven, so a reset on the way returns home from there (supervisor.h).
+************************************/
+void playback(struct Memory *m, struct DC_motor *mL, struct DC_motor *mR)
+{
+    int last = m->step;
+    unsigned char task = supervisor_require(SUP_PATH); // Checks in once per leg
+    for(m->step = 0; m->step <= last; m->step++)
+    {
+        supervisor_checkin(SUP_PATH);
+        driveLeg(mL,mR,m->time_forward[m->step]);
+        if(m->turn[m->step]){turnCard(m->turn[m->step],mL,mR);}
+    }
+    m->step = last;
+    stop(mL,mR);
+    supervisor_require(task);
+}
+
+/************************************
+ * Function to load the motor curves from the data EEPROM
+ * Inputs: DC_motor structure and pointer for the left motor and the right motor.
+ * Outputs: None
+ * Functions called within: hal_eeprom_read(). Without a valid saved calibration (marker and checksum)
+ * both curves are set to duty = power, the behaviour of an untrimmed buggy.
+************************************/
+void motorCalLoad(struct DC_motor *mL, struct DC_motor *mR)
+{
+    unsigned char i, sum = 0;
+    for(i = 0; i < 11; i++)
+    {
+        mL->curve[i] = hal_eeprom_read(EE_MOTOR_CAL + 1 + i);
+        mR->curve[i] = hal_eeprom_read(EE_MOTOR_CAL + 12 + i);
+        sum = sum + mL->curve[i] + mR->curve[i];
+    }
+    if(hal_eeprom_read(EE_MOTOR_CAL) == MOTOR_CAL_MARKER && hal_eeprom_read(EE_MOTOR_CAL + 23) == sum){return;}
+    for(i = 0; i < 11; i++)
+    {
+        mL->curve[i] = i * 10;
+        mR->curve[i] = i * 10;
+    }
+}
+
+/************************************
+ * Function to save the motor curves to the data EEPROM
+ * Inputs: DC_motor structure and pointer for the left motor and the right motor.
+ * Outputs: None
+ * Functions called within: hal_eeprom_write(), the marker is written last so an interrupted save is not loaded
+************************************/
+void motorCalSave(struct DC_motor *mL, struct DC_motor *mR)
+{
+    unsigned char i, sum = 0;
+    hal_eeprom_write(EE_MOTOR_CAL, 0xFF);
+    for(i = 0; i < 11; i++)
+    {
+        hal_eeprom_write(EE_MOTOR_CAL + 1 + i, mL->curve[i]);
+        hal_eeprom_write(EE_MOTOR_CAL + 12 + i, mR->curve[i]);
+        sum = sum + mL->curve[i] + mR->curve[i];
+    }
+    hal_eeprom_write(EE_MOTOR_CAL + 23, sum);
+    hal_eeprom_write(EE_MOTOR_CAL, MOTOR_CAL_MARKER);
+}
+
+/************************************
+ * Function to load the speed table from the data EEPROM
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: hal_eeprom_read(). Without a valid saved table (marker and checksum) the speed
+ * table of the robot profile is kept.
+************************************/
+void motorSpeedLoad(void)
+{
+    unsigned char table[11];
+    unsigned char i, sum = 0;
+    for(i = 0; i < 11; i++)
+    {
+        table[i] = hal_eeprom_read(EE_SPEED_CAL + 1 + i);
+        sum = sum + table[i];
+    }
+    if(hal_eeprom_read(EE_SPEED_CAL) != SPEED_CAL_MARKER || hal_eeprom_read(EE_SPEED_CAL + 12) != sum){return;}
+    memcpy(speed_table, table, sizeof(speed_table));
+}
+
+/************************************
+ * Function to use and save a measured speed table
+ * Inputs: Wheel speed at 0, 10, ... 100% power in % of full speed, not decreasing
+ * Outputs: None
+ * Functions called within: hal_eeprom_write(), the marker is written last so an interrupted save is not loaded
+************************************/
+void motorSpeedSave(const unsigned char *table)
+{
+    unsigned char i, sum = 0;
+    memcpy(speed_table, table, sizeof(speed_table));
+    hal_eeprom_write(EE_SPEED_CAL, 0xFF);
+    for(i = 0; i < 11; i++)
+    {
+        hal_eeprom_write(EE_SPEED_CAL + 1 + i, table[i]);
+        sum = sum + table[i];
+    }
+    hal_eeprom_write(EE_SPEED_CAL + 12, sum);
+    hal_eeprom_write(EE_SPEED_CAL, SPEED_CAL_MARKER);
+}
+
+/************************************
+ * Function to trim the curves at one power level after the buggy veered towards the slow motor
+ * Inputs: DC_motor structure and pointer for the faster and the slower motor, level 0-10 of the curves
+ * Outputs: None
+ * Functions called within: None
+ * The slow motor is first brought back up to its untrimmed duty, then the fast one is trimmed down,
+ * so the faster motor is always the one slowed and full power stays reachable by one of them.
+************************************/
+static void motorTrim(struct DC_motor *fast, struct DC_motor *slow, unsigned char level)
+{
+    if(slow->curve[level] < level * 10){slow->curve[level]++;}
+    else if(fast->curve[level] > 0){fast->curve[level]--;}
+}
+
+/************************************
+ * Guided calibration of the motor curves over the serial terminal, the buggy needs a clear straight run
+ * Inputs: DC_motor structure and pointer for the left motor and the right motor.
+ * Outputs: None
+ * Functions called within: driveForward() and stop() for the test runs, motorTrim(), motorCalSave()
+ * For each power from 30% (the wheels stall below) to 100% the operator sends
+ *   g  drive straight for MOTOR_CAL_RUN_MS at that power
+ *   <  the buggy veered left, i.e. the right motor is faster, trim by 1%
+ *   >  the buggy veered right
+ *   n  the run was straight, go to the next power
+ *   x  abort and keep the saved curves, as does no answer within MOTOR_CAL_WAIT_MS
+ * The curves are saved to the data EEPROM after the last power.
+************************************/
+void motorCalibrate(struct DC_motor *mL, struct DC_motor *mR)
+{
+    char msg[40];
+    unsigned char level = 3;
+    unsigned char task = supervisor_require(SUP_CAL);
+    unsigned int t;
+    unsigned long start;
+    char c;
+    
+    stop(mL,mR);
+    sendStringSerial4("Motor calibration: g run, < veers left, > veers right, n next, x abort\n");
+    while(level <= 10)
+    {
+        sprintf(msg,"power %d L %d R %d\n",level * 10,mL->curve[level],mR->curve[level]);
+        sendStringSerial4(msg);
+        c = 'x'; // No answer within MOTOR_CAL_WAIT_MS aborts
+        start = get_ms();
+        while(get_ms() - start < MOTOR_CAL_WAIT_MS) // Wait for the operator
+        {
+            if(isDataInRxBuf())
+            {
+                c = getCharFromRxBuf();
+                break;
+            }
+            supervisor_checkin(SUP_CAL);
+            power_wait_ms(10);
+        }
+        if(c == 'g')
+        {
+            driveForward(mL,mR,level * 10);
+            for(t = 0; t < MOTOR_CAL_RUN_MS; t += 10)
+            {
+                supervisor_checkin(SUP_CAL);
+                power_wait_ms(10);
+            }
+            stop(mL,mR);
+        }
+        else if(c == '<'){motorTrim(mR,mL,level);}
+        else if(c == '>'){motorTrim(mL,mR,level);}
+        else if(c == 'n'){level++;}
+        else if(c == 'x')
+        {
+            motorCalLoad(mL,mR); // Drop the changes
+            sendStringSerial4("Motor calibration aborted\n");
+            supervisor_require(task);
+            return;
+        }
+    }
+    motorCalSave(mL,mR);
+    sendStringSerial4("Motor calibration saved\n");
+    supervisor_require(task);
+}
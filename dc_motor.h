@@ -1,9 +1,24 @@
 #ifndef _DC_MOTOR_H
 #define _DC_MOTOR_H
 
-#include <xc.h>
+#include "hal.h"
+#include "color.h"
 
-#define _XTAL_FREQ 64000000
+// Forward powers, braking and turn times are set in the robot profile (robot_config.h)
+
+#define EE_MOTOR_CAL 0x000  // Data EEPROM address of the motor curves: marker, left curve, right curve, checksum
+#define MOTOR_CAL_MARKER 'M' // Marks a saved calibration, erased EEPROM reads 0xFF
+#define MOTOR_CAL_RUN_MS 2000 // Length of a straight test run during motorCalibrate()
+#define MOTOR_CAL_WAIT_MS 60000UL // Longest wait for the operator during motorCalibrate() before it aborts
+#define EE_SPEED_CAL 0x040  // Data EEPROM address of the speed table: marker, 11 speeds, checksum
+#define SPEED_CAL_MARKER 'V' // Marks a saved speed table
+
+#define PATH_TURNS "bPROGBY" // Turn codes kept in the path memory
+
+// What retrace() has left to do at the current step, so it can resume after a reset
+#define RETRACE_OFF     0   // Not retracing
+#define RETRACE_TURN    1   // Undo the turn, then drive the leg
+#define RETRACE_LEG     2   // Drive the leg
 
 
 struct DC_motor { //definition of DC_motor structure
@@ -13,22 +28,37 @@ struct DC_motor { //definition of DC_motor structure
     unsigned char *dir_LAT; //LAT for dir pin
     char dir_pin; // pin number that controls direction on LAT
     int PWMperiod; //base period of PWM cycle
+    int speed; //wheel speed set by setMotorPWM(), % of full speed, negative in reverse
+    unsigned char curve[11]; //PWM duty in % for power 0, 10, ... 100, trims the motor to match the other one
 };
 
 struct Memory { //Definition of the path memory structure
-    int time_forward[50]; //path memory array for time driven forward for maximum 50 steps
-    char turn[50]; //path memory array for the turn after each time driven forward for maximum 50 steps
+    int time_forward[PATH_STEPS]; //path memory array for the distance driven forward (ms at full speed) for maximum PATH_STEPS steps
+    char turn[PATH_STEPS + 1]; //path memory array for the turn after each time driven forward for maximum PATH_STEPS steps, 0 terminated
+    int step; //current position in the path memory arrays, counts down while retracing
+    unsigned char retracing; //RETRACE_ state of the current step
 };
 
 //function prototypes (Function descriptions are to be found in the .c file)
 void initDCmotorsPWM(int PWMperiod); // function to setup PWM
 void setMotorPWM(struct DC_motor *m);
+void setMotorPWMTick(struct DC_motor *m);
 void stop(struct DC_motor *mL, struct DC_motor *mR);
-void turnLeft(struct DC_motor *mL, struct DC_motor *mR);
-void turnRight(struct DC_motor *mL, struct DC_motor *mR);
+void turnLeft(struct DC_motor *mL, struct DC_motor *mR, int degrees, unsigned int ms);
+void turnRight(struct DC_motor *mL, struct DC_motor *mR, int degrees, unsigned int ms);
+void driveForward(struct DC_motor *mL, struct DC_motor *mR, char power);
+char approachPower(struct Color_stream *s);
+int motorSpeed(char power);
+long odometerRead(void);
 void fullSpeedAhead(struct DC_motor *mL, struct DC_motor *mR);
 void fullSpeedBack(struct DC_motor *mL, struct DC_motor *mR);
 void addPathtoMemory(struct Memory *m,int step, int count, int action);
-void retrace(struct Memory *m,struct DC_motor *motorL, struct DC_motor *motorR, int step);
+void retrace(struct Memory *m,struct DC_motor *motorL, struct DC_motor *motorR);
+void playback(struct Memory *m, struct DC_motor *mL, struct DC_motor *mR);
+void motorCalLoad(struct DC_motor *mL, struct DC_motor *mR);
+void motorCalSave(struct DC_motor *mL, struct DC_motor *mR);
+void motorCalibrate(struct DC_motor *mL, struct DC_motor *mR);
+void motorSpeedLoad(void);
+void motorSpeedSave(const unsigned char *table);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "gyro.h"
+#include "i2c.h"
+#include "timers.h"
+#include "power.h"
+
+static char gyro_ok = 0;    // Gyro found and set up by gyro_init(), cleared by a reset so safe mode keeps off the bus
+static int gyro_bias = 0;   // Raw GYRO_ZOUT standing still
+
+/************************************
+ * Function to write a register of the gyro
+ * Inputs: Register address, value to be stored
+ * Outputs: None
+ * Functions called within: The I2C functions, as in color_writetoaddr() without the command bit
+************************************/
+static void gyro_writetoaddr(char address, char value)
+{
+    I2C_2_Master_Start();         //Start condition
+    I2C_2_Master_Write(GYRO_ADDR | 0x00);     //7 bit device address + Write mode
+    I2C_2_Master_Write(address);    //register address
+    I2C_2_Master_Write(value);
+    I2C_2_Master_Stop();          //Stop condition
+}
+
+/************************************
+ * Function to read one register of the gyro
+ * Inputs: Register address
+ * Outputs: Register value, 0xFF if there is no gyro on the bus
+ * Functions called within: The I2C functions, as in color_readfromaddr()
+************************************/
+static unsigned char gyro_readfromaddr(char address)
+{
+    unsigned char value;
+    I2C_2_Master_Start();         //Start condition
+    I2C_2_Master_Write(GYRO_ADDR | 0x00);     //7 bit address + Write mode
+    I2C_2_Master_Write(address);    //register address
+    I2C_2_Master_RepStart();			// start a repeated transmission
+    I2C_2_Master_Write(GYRO_ADDR | 0x01);     //7 bit address + Read (1) mode
+    value = I2C_2_Master_Read(0);        //read the register (don't acknowledge, single read)
+    I2C_2_Master_Stop();          //Stop condition
+    return value;
+}
+
+/************************************
+ * Function to read the raw yaw rate
+ * Inputs: None
+ * Outputs: Signed GYRO_ZOUT, GYRO_LSB_PER_DPS counts per degree/s
+ * Functions called within: The I2C functions, the register pointer moves on from the high to the low byte
+************************************/
+static int gyro_read_z(void)
+{
+    int tmp;
+    I2C_2_Master_Start();         //Start condition
+    I2C_2_Master_Write(GYRO_ADDR | 0x00);     //7 bit address + Write mode
+    I2C_2_Master_Write(0x47);    //start at GYRO_ZOUT_H
+    I2C_2_Master_RepStart();			// start a repeated transmission
+    I2C_2_Master_Write(GYRO_ADDR | 0x01);     //7 bit address + Read (1) mode
+    tmp = (signed char)I2C_2_Master_Read(1) * 256;     //read the MSB, sign extended
+    tmp = tmp | I2C_2_Master_Read(0);    //read the LSB (don't acknowledge as this is the last read)
+    I2C_2_Master_Stop();          //Stop condition
+    return tmp;
+}
+
+/************************************
+ * Function to find and set up the gyro, called after color_click_init() has set up the I2C bus
+ * Inputs: None
+ * Outputs: 1 if the gyro answered, 0 if the turns stay timed
+ * Functions called within: gyro_writetoaddr() wakes the gyro on its own clock, sets a 1kHz sample rate with
+ * the 98Hz low pass filter and the +-500 degrees/s range, then gyro_read_z() is averaged for the bias. The
+ * buggy must stand still until it returns, about 90ms.
+************************************/
+char gyro_init(void)
+{
+    long sum = 0;
+    char i;
+    gyro_ok = 0;
+    if(gyro_readfromaddr(0x75) != 0x68){return 0;} // WHO_AM_I
+    gyro_writetoaddr(0x6B, 0x01); // PWR_MGMT_1: awake, clocked by the X gyro PLL
+    gyro_writetoaddr(0x19, 0x00); // SMPLRT_DIV: 1kHz
+    gyro_writetoaddr(0x1A, 0x02); // CONFIG: 98Hz low pass filter
+    gyro_writetoaddr(0x1B, 0x08); // GYRO_CONFIG: +-500 degrees/s
+    power_wait_ms(GYRO_START_MS);
+    for(i = 0; i < GYRO_BIAS_SAMPLES; i++)
+    {
+        sum += gyro_read_z();
+        power_wait_ms(1);
+    }
+    gyro_bias = (int)(sum / GYRO_BIAS_SAMPLES);
+    gyro_ok = 1;
+    return 1;
+}
+
+/************************************
+ * Function to tell whether turns can be closed on the gyro
+ * Inputs: None
+ * Outputs: 1 once gyro_init() has found the gyro
+ * Functions called within: None
+************************************/
+char gyro_present(void)
+{
+    return gyro_ok;
+}
+
+/************************************
+ * Function to start integrating the yaw
+ * Inputs: Gyro_yaw structure and pointer g
+ * Outputs: None, g is at 0 degrees from now
+ * Functions called within: gyro_read_z() for the starting rate
+************************************/
+void gyro_zero(struct Gyro_yaw *g)
+{
+    g->rate = (gyro_read_z() - gyro_bias) / GYRO_LSB_PER_DPS;
+    g->stamp = get16bitTMR1val();
+    g->yaw = 0;
+}
+
+/************************************
+ * Function to add the yaw turned since the last sample
+ * Inputs: Gyro_yaw structure and pointer g
+ * Outputs: None, g holds the new yaw and rate
+ * Functions called within: gyro_read_z(), the rate is integrated with the trapezoid rule over the Timer1
+ * time since the last sample, which must be called again within 32ms before Timer1 wraps
+************************************/
+void gyro_update(struct Gyro_yaw *g)
+{
+    float rate = (gyro_read_z() - gyro_bias) / GYRO_LSB_PER_DPS;
+    unsigned int now = get16bitTMR1val();
+    g->yaw += (g->rate + rate) / 2 * ((now - g->stamp) & 0xFFFF) * 0.0000005; // 0.5us per Timer1 count, 16 bit also where int is wider
+    g->rate = rate;
+    g->stamp = now;
+}
@@ -0,0 +1,30 @@
+#ifndef _gyro_H
+#define _gyro_H
+
+#include "hal.h"
+
+/************************************
+ * Gyro of an MPU-6050 IMU on the SSP2 I2C bus, shared with the colour click (address 0x68, the TCS3471 is 0x29)
+ * Only the yaw axis (GYRO_ZOUT) is read. gyro_init() sets it to +-500 degrees/s and measures its bias while
+ * the buggy stands still, then a turn integrates the yaw rate from gyro_zero() with gyro_update(), timed by
+ * the 0.5us Timer1 count. Without a gyro on the bus the turns stay timed (motion.h).
+************************************/
+
+#define GYRO_ADDR           0xD0    // 7 bit address 0x68 shifted left, AD0 low
+#define GYRO_LSB_PER_DPS    65.5    // GYRO_CONFIG FS_SEL 1, +-500 degrees/s
+#define GYRO_START_MS       50      // Gyro start up time after waking, before the bias is measured
+#define GYRO_BIAS_SAMPLES   32      // Samples 1ms apart averaged for the bias
+
+struct Gyro_yaw { //Yaw integrated since gyro_zero()
+    float yaw;              // degrees turned, counterclockwise (left) positive
+    float rate;             // degrees/s of the last sample
+    unsigned int stamp;     // Timer1 count of the last sample
+};
+
+//function prototypes (Function descriptions are to be found in the .c file)
+char gyro_init(void);
+char gyro_present(void);
+void gyro_zero(struct Gyro_yaw *g);
+void gyro_update(struct Gyro_yaw *g);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef _hal_H
+#define _hal_H
+
+/************************************
+ * Hardware abstraction layer
+ * All modules access GPIO, PWM, I2C, UART, timers, interrupt flags and delays through the 
+ * HAL_ macros and hal_ functions below instead of touching PIC registers directly.
+ * The PIC backend (hal_pic.h/hal_pic.c) maps every macro straight onto the register it replaces,
+ * so the firmware compiles to the same code as before. Building with HAL_POSIX defined selects
+ * the POSIX backend in host/ which lets the full firmware run as a Linux executable (make host).
+************************************/
+// Events reported through HAL_PROBE(event, value), compiled out on the PIC
+#define PROBE_CLASSIFY  1   // value: card code returned by classify_RGB()
+#define PROBE_RETRACE   2   // value: 1 when retrace() starts, 0 when it ends
+#define PROBE_RECORD    3   // value: source of a colour read just stored by record_read()
+
+// Causes of the last reset returned by hal_reset_cause()
+#define RESET_POWER     'P' // Power on, RAM contents undefined
+#define RESET_MCLR      'M' // Reset button
+#define RESET_BROWNOUT  'B' // Supply dropped below the brown-out level
+#define RESET_WDT       'W' // Watchdog timeout, the firmware hung
+#define RESET_SOFT      'S' // RESET instruction, a fault detected by the firmware
+#define RESET_STACK     'K' // Hardware stack overflow or underflow
+
+#define HAL_WDT_MS      1000 // Watchdog period, HAL_WDT_START() of each backend
+
+#define EEPROM_SIZE     1024 // Bytes of data EEPROM, the persistent settings are laid out in the modules that own them
+
+// Generated from the robot profile (profiles/), sets _XTAL_FREQ and the tuning constants
+#ifdef HAL_POSIX
+#include "robot_config.h"               // build/host/<profile>, on the include path of host.mk
+#else
+#include "build/config/robot_config.h"  // Next to this file, found by XC8 without an include directory
+#endif
+
+#ifdef HAL_POSIX
+#include "hal_posix.h"
+#else
+#include "hal_pic.h"
+#endif
+
+//function prototypes implemented by each backend (Function descriptions are to be found in the .c file)
+void hal_gpio_init(void);
+void hal_pwm_init(int PWMperiod);
+void hal_i2c_init(void);
+void hal_uart_init(void);
+void hal_timer0_init(void);
+void hal_timer1_init(void);
+void hal_interrupts_init(void);
+void hal_power_init(void);
+char hal_reset_cause(void);
+unsigned char hal_eeprom_read(unsigned int addr);
+void hal_eeprom_write(unsigned int addr, unsigned char value);
+
+#endif
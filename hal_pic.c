@@ -0,0 +1,287 @@
+#include <xc.h>
+#include "hal.h"
+#include "i2c.h"
+
+/************************************
+ * Function to configure the buggy and clicker 2 LED pins as outputs
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void hal_gpio_init(void)
+{
+    //Initialize pins for car LEDs as outputs
+    TRISDbits.TRISD3 = 0; // Main Beam (Full brightness)
+    TRISDbits.TRISD4 = 0; // Brake (Full brightness)
+    TRISFbits.TRISF0 = 0; // Turn Left
+    TRISHbits.TRISH0 = 0; // Turn Right
+    TRISHbits.TRISH1 = 0; // Headlamps (Front + Rear at reduced brightness)
+    
+    // Initialize pins for RGB
+    TRISGbits.TRISG1 = 0; // Red LED
+    TRISAbits.TRISA4 = 0; // Green LED
+    TRISFbits.TRISF7 = 0; // Blue LED
+    
+    //Initializing the debugging LED
+    TRISHbits.TRISH3 = 0;
+}
+
+/************************************
+ * Function to initialise Timer2 and PWM for DC motor control
+ * Inputs: Pulse Width Modulated signal period length in ms
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void hal_pwm_init(int PWMperiod)
+{
+	//initialise your TRIS and LAT registers for PWM
+    TRISEbits.TRISE4 = 0; 
+    TRISGbits.TRISG6 = 0; 
+    TRISCbits.TRISC7 = 0;
+    TRISEbits.TRISE2 = 0;
+  
+    LATEbits.LATE4 = 0;
+    LATGbits.LATG6 = 0;
+    LATEbits.LATE2 = 0;
+    LATCbits.LATC7 = 0;
+
+    
+    // timer 2 config
+    T2CONbits.CKPS=0b0011; // 1:8 prescaler. Calculated 6.22 but taking larger prescaler for longer overflow.
+    T2HLTbits.MODE=0b00000; // Free Running Mode, software gate only
+    T2CLKCONbits.CS=0b0001; // Fosc/4
+
+    // Tpwm*(Fosc/4)/prescaler - 1 = PTPER
+    T2PR= PWMperiod; //Period reg 10kHz base period. Calculated with a PS = 8. Timer2 count required for overflow. (was 199 bef changed to PWMperiod))
+    T2CONbits.ON=1;
+    
+    RE2PPS=0x0A; //PWM6 on RE2
+    RC7PPS=0x0B; //PMW7 on RC7
+
+    PWM6DCH=0; //0% power. Send frac value out of 199 for %.
+    PWM7DCH=0; //0% power. Send frac value out of 199 for %.
+    
+    PWM6CONbits.EN = 1;
+    PWM7CONbits.EN = 1;
+}
+
+/************************************
+ * Function to inialise the MSSP2 module and pins for I2C
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void hal_i2c_init(void)
+{
+  //i2c config  
+  SSP2CON1bits.SSPM= 0b1000;    // i2c master mode
+  SSP2CON1bits.SSPEN = 1;       //enable i2c
+  SSP2ADD = (_XTAL_FREQ/(4*_I2C_CLOCK))-1; //Baud rate divider bits (in master mode)
+  
+  //pin configuration for i2c  
+  TRISDbits.TRISD5 = 1;                   //Disable output driver
+  TRISDbits.TRISD6 = 1;                   //Disable output driver
+  ANSELDbits.ANSELD5=0;
+  ANSELDbits.ANSELD6=0;
+  SSP2DATPPS=0x1D;      //pin RD5
+  SSP2CLKPPS=0x1E;      //pin RD6
+  RD5PPS=0x1C;      // data output
+  RD6PPS=0x1B;      //clock output
+}
+
+/************************************
+ * Function to initialise EUSART4
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void hal_uart_init(void)
+{
+    // Configure pins RC0 and RC1 to map to EUSART module
+    TRISCbits.TRISC1=1; 
+	RC0PPS = 0x12; // Map EUSART4 TX to RC0
+    RX4PPS = 0x11; // RX is RC1   
+    
+    // Set up EUSART to asyncronous baud rate 9600 using 8 bit baud rate generator value 
+    BAUD4CONbits.BRG16 = 0; 	//set baud rate scaling
+    TX4STAbits.BRGH = 0; 		//high baud rate select bit
+    SP4BRGL = 51; 			//set baud rate to 51 = 19200bps
+    SP4BRGH = 0;			//not used
+
+    RC4STAbits.CREN = 1; 		//enable continuos reception
+    TX4STAbits.TXEN = 1; 		//enable transmitter
+    RC4STAbits.SPEN = 1; 		//enable serial port
+}
+
+/************************************
+ * Function to initialise Timer0 as the 1ms system tick
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: None
+ * Timer0 runs in 8 bit mode with TMR0H as period register, Fosc/4 with a 1:64 prescaler
+ * gives 250kHz, so a period of 250 counts overflows every 1ms.
+************************************/
+void hal_timer0_init(void)
+{
+    T0CON1bits.T0CS = 0b010;   // Fosc/4
+    T0CON1bits.T0ASYNC = 1;    // Needed to ensure correct operation when Fosc/4 used as clock source
+    T0CON1bits.T0CKPS = 0b0110; // 1:64 prescaler
+    T0CON0bits.T016BIT = 0;    // 8 bit mode, TMR0H is the period register
+    T0CON0bits.T0OUTPS = 0b0000; // 1:1 postscaler
+    TMR0H = 249;               // 250 counts at 250kHz = 1ms
+    TMR0L = 0;
+    PIE0bits.TMR0IE = 1;       // Enable the Timer0 interrupt
+    IPR0bits.TMR0IP = 0;       // Low priority, serviced in LowISR
+    T0CON0bits.T0EN = 1;       // Start the timer
+}
+
+/************************************
+ * Function to initialise Timer1 as a free running 16 bit counter
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: None
+ * Fosc/4 with a 1:8 prescaler gives 0.5us per count, overflowing every 32.7ms.
+************************************/
+void hal_timer1_init(void)
+{
+    T1CLKbits.CS = 0b0001;     // Fosc/4
+    T1CONbits.CKPS = 0b11;     // 1:8 prescaler
+    T1CONbits.RD16 = 1;        // 16 bit reads, TMR1H is latched when TMR1L is read
+    TMR1H = 0;
+    TMR1L = 0;
+    T1CONbits.ON = 1;          // Start the timer
+}
+
+/************************************
+ * Function to initialize the interrupts on the master device (clicker 2)
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void hal_interrupts_init(void)
+{
+    // Turn on Global Interrupts, Peripheral Interrupts, and Interrupt Source (Turn on Global last)
+    PIE4bits.RC4IE=1;	//receive interrupt
+    //transmit interrupt (only turn on when you have more than one byte to send)
+    INTCONbits.IPEN = 1; // Enaable priority levels on interrupt
+    INTCONbits.GIEL = 1; //Enable peripheral interrupt
+    INTCONbits.GIEH = 1; // Enable global interrupt
+    
+    //MSSP2 interrupt, only to wake the core from Idle at the end of an I2C transfer (see i2c.c)
+    PIE3bits.SSP2IE = 1;
+    IPR3bits.SSP2IP = 0; //Low priority, the flag is cleared in LowISR
+    
+    //Enabling external interrupts on the clicker board
+    PIE0bits.INT1IE = 1; //Enabling interrupt INT0
+    IPR0bits.INT1IP = 0; //Setting interrupt priority high (1) or low (0)
+    INTCONbits.GIE = 1; //Enabling global interrupts to have the processor branch to the interrupt vector following wakeup
+    INTCONbits.INT1EDG = 0; //Interrupt set to occur on a falling edge because the the interrupt on the TCS causes the pin to go low
+    INT1PPS = 0b001001; //Setting RB1 as the interrupt pin (it is by default, just to be sure)
+    
+    //Initializing the external interrupt pin on the board
+    TRISBbits.TRISB1 = 1;
+    ANSELBbits.ANSELB1=0;
+}
+
+/************************************
+ * Function to switch off the unused peripherals and make SLEEP enter Idle mode
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: None
+ * A module disabled in PMDx is held in reset with its clock removed. Kept on: Timer0 (tick),
+ * Timer1 (trace), Timer2 with PWM6/7 (motors), MSSP2 (colour click), EUSART4, NVM (EEPROM) and IOC.
+************************************/
+void hal_power_init(void)
+{
+    CPUDOZEbits.IDLEN = 1;  // SLEEP stops the CPU only, the oscillator and the peripherals keep running
+    
+    PMD0bits.FVRMD = 1;     // Fixed voltage reference
+    PMD0bits.HLVDMD = 1;    // High/low voltage detect
+    PMD0bits.CRCMD = 1;     // CRC
+    PMD0bits.SCANMD = 1;    // NVM scanner
+    PMD0bits.CLKRMD = 1;    // Reference clock output
+    PMD1bits.TMR3MD = 1;    // Timers 3 to 8
+    PMD1bits.TMR4MD = 1;
+    PMD1bits.TMR5MD = 1;
+    PMD1bits.TMR6MD = 1;
+    PMD1bits.TMR7MD = 1;
+    PMD2bits.TMR8MD = 1;
+    PMD2bits.ADCMD = 1;     // ADC, comparators, DAC and zero cross detect
+    PMD2bits.CMP1MD = 1;
+    PMD2bits.CMP2MD = 1;
+    PMD2bits.CMP3MD = 1;
+    PMD2bits.DACMD = 1;
+    PMD2bits.ZCDMD = 1;
+    PMD3bits.CCP1MD = 1;    // Capture/compare modules
+    PMD3bits.CCP2MD = 1;
+    PMD3bits.CCP3MD = 1;
+    PMD3bits.CCP4MD = 1;
+    PMD3bits.CCP5MD = 1;
+    PMD4bits.CWGMD = 1;     // Complementary waveform generator
+    PMD4bits.MSSP1MD = 1;   // MSSP1, the colour click is on MSSP2
+    PMD5bits.UART1MD = 1;   // EUSARTs other than EUSART4
+    PMD5bits.UART2MD = 1;
+    PMD5bits.UART3MD = 1;
+    PMD5bits.UART5MD = 1;
+    PMD5bits.DSMMD = 1;     // Data signal modulator
+}
+
+/************************************
+ * Function to find the cause of the last reset
+ * Inputs: None
+ * Outputs: One of the RESET_ codes of hal.h
+ * Functions called within: None
+ * The PCON0 flags are cleared by the reset of their kind and must be set again by software,
+ * so they are re-armed here for the next reset.
+************************************/
+char hal_reset_cause(void)
+{
+    char cause;
+    if(!PCON0bits.nPOR){cause = RESET_POWER;}
+    else if(!PCON0bits.nBOR){cause = RESET_BROWNOUT;}
+    else if(!PCON0bits.nRWDT){cause = RESET_WDT;}
+    else if(!PCON0bits.nRI){cause = RESET_SOFT;}
+    else if(PCON0bits.STKOVF || PCON0bits.STKUNF){cause = RESET_STACK;}
+    else{cause = RESET_MCLR;}
+    PCON0 = 0b00111111;     // Stack flags clear, reset flags set
+    return cause;
+}
+
+/************************************
+ * Function to read a byte of the data EEPROM
+ * Inputs: Address, 0 to EEPROM_SIZE-1
+ * Outputs: The byte stored at the address, 0xFF if never written
+ * Functions called within: None
+************************************/
+unsigned char hal_eeprom_read(unsigned int addr)
+{
+    NVMCON1bits.NVMREG = 0b00;  // Access the data EEPROM
+    NVMADRH = (unsigned char)(addr >> 8);
+    NVMADRL = (unsigned char)addr;
+    NVMCON1bits.RD = 1;         // The data is available in the next cycle
+    return NVMDAT;
+}
+
+/************************************
+ * Function to write a byte of the data EEPROM, waits for the ~4ms erase/write to finish
+ * Inputs: Address, 0 to EEPROM_SIZE-1, and the byte to store
+ * Outputs: None
+ * Functions called within: None
+ * Interrupts are held off for the unlock sequence, which must not be interrupted.
+************************************/
+void hal_eeprom_write(unsigned int addr, unsigned char value)
+{
+    unsigned char gie = INTCONbits.GIE;
+    if(hal_eeprom_read(addr) == value){return;} // Save a write cycle
+    NVMADRH = (unsigned char)(addr >> 8);
+    NVMADRL = (unsigned char)addr;
+    NVMDAT = value;
+    NVMCON1bits.WREN = 1;
+    INTCONbits.GIE = 0;
+    NVMCON2 = 0x55;             // Unlock sequence
+    NVMCON2 = 0xAA;
+    NVMCON1bits.WR = 1;
+    INTCONbits.GIE = gie;
+    while(NVMCON1bits.WR);      // Cleared by hardware when the write is complete, the watchdog catches a write that never ends
+    NVMCON1bits.WREN = 0;
+}
@@ -0,0 +1,68 @@
+#ifndef _hal_pic_H
+#define _hal_pic_H
+
+#include <xc.h>
+
+// GPIO, every pin is an LAT bit that can be assigned and read
+#define PIN_BEAM        LATDbits.LATD3  // Main Beam (Full brightness)
+#define PIN_BRAKE       LATDbits.LATD4  // Brake (Full brightness)
+#define PIN_TURN_L      LATFbits.LATF0  // Turn Left
+#define PIN_TURN_R      LATHbits.LATH0  // Turn Right
+#define PIN_HEADLAMPS   LATHbits.LATH1  // Headlamps (Front + Rear at reduced brightness)
+#define PIN_LED_RED     LATGbits.LATG1  // Red LED of the colour click
+#define PIN_LED_GREEN   LATAbits.LATA4  // Green LED of the colour click
+#define PIN_LED_BLUE    LATFbits.LATF7  // Blue LED of the colour click
+#define PIN_DEBUG       LATHbits.LATH3  // Debugging LED on the clicker 2
+
+#define HAL_GPIO_WRITE(pin, value) ((pin) = (value))
+#define HAL_GPIO_READ(pin)         (pin)
+#define HAL_GPIO_TOGGLE(pin)       ((pin) = !(pin))
+
+// PWM duty and direction registers of the two motors, stored as addresses in struct DC_motor
+#define HAL_MOTOR_L_DUTY    PWM6DCH
+#define HAL_MOTOR_L_DIR_LAT LATE
+#define HAL_MOTOR_L_DIR_PIN 4       // pin RE4 controls direction for motorL
+#define HAL_MOTOR_R_DUTY    PWM7DCH
+#define HAL_MOTOR_R_DIR_LAT LATG
+#define HAL_MOTOR_R_DIR_PIN 6       // pin RG6 controls direction for motorR
+
+// I2C master on MSSP2
+#define HAL_I2C_BUSY()      ((SSP2STAT & 0x04) || (SSP2CON2 & 0x1F))
+#define HAL_I2C_START()     (SSP2CON2bits.SEN = 1)
+#define HAL_I2C_RESTART()   (SSP2CON2bits.RSEN = 1)
+#define HAL_I2C_STOP()      (SSP2CON2bits.PEN = 1)
+#define HAL_I2C_WRITE(b)    (SSP2BUF = (b))
+#define HAL_I2C_RECEIVE()   (SSP2CON2bits.RCEN = 1)
+#define HAL_I2C_READ()      (SSP2BUF)
+#define HAL_I2C_ACK(ack)    do { SSP2CON2bits.ACKDT = !(ack); SSP2CON2bits.ACKEN = 1; } while(0)
+
+// EUSART4
+#define HAL_UART_RX_READY()     (PIR4bits.RC4IF)
+#define HAL_UART_READ()         (RC4REG)
+#define HAL_UART_TX_READY()     (PIR4bits.TX4IF)
+#define HAL_UART_WRITE(c)       (TX4REG = (c))
+#define HAL_UART_TX_INT(on)     (PIE4bits.TX4IE = (on))
+
+// Interrupt flags
+#define HAL_INT1_FLAG   PIR0bits.INT1IF
+#define HAL_TMR0_FLAG   PIR0bits.TMR0IF
+#define HAL_I2C_FLAG    PIR3bits.SSP2IF     // Only enabled to wake the core from Idle
+#define HAL_INTERRUPTS(on)  (INTCONbits.GIE = (on))
+
+// Timers and delays
+#define HAL_TMR1_READ()     (TMR1)      // 16 bit read, low byte first so TMR1H is latched (RD16)
+#define HAL_TMR0_COUNT()    (TMR0L)     // 4us counts within the current ms, 0 to 249
+#define HAL_DELAY_MS(x)     __delay_ms(x)
+
+// Power, SLEEP enters Idle mode as set by hal_power_init()
+#define HAL_IDLE()          SLEEP()
+
+// Watchdog under software control (WDTE = SWDTEN) and reset
+#define HAL_WDT_START()     (WDTCON0 = 0b00010101)  // 1:32768 of the 31kHz LFINTOSC (HAL_WDT_MS), SEN set
+#define HAL_WDT_CLEAR()     CLRWDT()
+#define HAL_RESET()         RESET()
+
+// Host instrumentation hook, nothing on the target
+#define HAL_PROBE(event, value) ((void)0)
+
+#endif
@@ -0,0 +1,107 @@
+#
+#  Host (POSIX) build of the firmware, selected by HAL_POSIX in hal.h
+#
+#     host                     build build/host/<profile>/buggy, the firmware as a Linux executable
+#     host-run                 run it for HOST_RUN_MS of virtual time
+#     host-sim                 build build/host/<profile>/sim, the maze simulator
+#     host-bench               run the simulator over every maze in HOST_MAZES
+#     host-dataset             record the colour reads of every maze in HOST_MAZES into HOST_DATASET
+#     host-replay              score the classifier of this build on HOST_DATASET
+#     host-mem                 per-module RAM/flash budget of build/host/<profile>/buggy from its linker map
+#     host-clean               remove the host build
+#
+#  PROFILE selects the robot profile (profiles/<profile>.profile), each profile builds in its own directory
+#
+
+HOST_CC ?= cc
+HOST_OBJCOPY ?= objcopy
+HOST_CFLAGS ?= -O2 -g -Wall -Wno-main -Wno-unknown-pragmas -Wno-char-subscripts
+PROFILE ?= default
+HOST_DIR = build/host/$(PROFILE)
+HOST_CPPFLAGS = -DHAL_POSIX -I$(HOST_DIR) -I. -Ihost
+HOST_RUN_MS ?= 10000
+HOST_MAZES ?= $(wildcard host/mazes/*.maze)
+HOST_SEED ?= 1
+
+# XC8 treats plain char as unsigned
+HOST_ALL_CFLAGS = $(HOST_CPPFLAGS) $(HOST_CFLAGS) -funsigned-char
+
+FIRMWARE_SRC = main.c color.c dc_motor.c gyro.c i2c.c interrupts.c lights.c mission.c motion.c perf.c power.c record.c serial.c supervisor.c timers.c trace.c turncal.c
+HOST_SRC = host/hal_posix.c host/host_main.c
+SIM_SRC = host/hal_posix.c host/mpu6050_model.c host/tcs3471_model.c host/sim.c
+REPLAY_SRC = host/hal_posix.c host/replay.c
+
+FIRMWARE_OBJ = $(addprefix $(HOST_DIR)/,$(FIRMWARE_SRC:.c=.o))
+HOST_OBJ = $(addprefix $(HOST_DIR)/,$(HOST_SRC:.c=.o))
+SIM_OBJ = $(addprefix $(HOST_DIR)/,$(SIM_SRC:.c=.o))
+REPLAY_OBJ = $(addprefix $(HOST_DIR)/,$(REPLAY_SRC:.c=.o))
+HOST_DATASET ?= $(HOST_DIR)/dataset.txt
+
+host: $(HOST_DIR)/buggy $(HOST_DIR)/sim $(HOST_DIR)/replay
+
+# Configuration header generated from the robot profile, profiles may include each other
+$(HOST_DIR)/robot_config.h: profiles/$(PROFILE).profile $(wildcard profiles/*.profile) profiles/gen_config.py
+	@$(MKDIR) -p $(dir $@)
+	python3 profiles/gen_config.py $< $@
+
+$(FIRMWARE_OBJ) $(HOST_OBJ) $(SIM_OBJ) $(REPLAY_OBJ): $(HOST_DIR)/robot_config.h
+
+host-sim: $(HOST_DIR)/sim
+
+$(HOST_DIR)/buggy: $(FIRMWARE_OBJ) $(HOST_OBJ)
+	$(HOST_CC) -o $@ $^ -lm -Wl,-Map=$@.map
+
+$(HOST_DIR)/sim: $(FIRMWARE_OBJ) $(SIM_OBJ)
+	$(HOST_CC) -o $@ $^ -lm
+
+$(HOST_DIR)/replay: $(FIRMWARE_OBJ) $(REPLAY_OBJ)
+	$(HOST_CC) -o $@ $^ -lm
+
+# The variables of the firmware are moved to sections of their own, so hal_posix_boot() can clear them on a
+# reset as the XC8 startup code does, __persistent variables and those of the host programs are kept
+FW_SECTIONS = --rename-section .data=fw_data --rename-section .bss=fw_bss
+
+# main() of the firmware is renamed so the host entry point can set up the backend first
+$(HOST_DIR)/main.o: main.c
+	@$(MKDIR) -p $(dir $@)
+	$(HOST_CC) $(HOST_ALL_CFLAGS) -Dmain=firmware_main -MMD -c -o $@ $<
+	$(HOST_OBJCOPY) $(FW_SECTIONS) $@
+
+$(HOST_DIR)/host/%.o: host/%.c
+	@$(MKDIR) -p $(dir $@)
+	$(HOST_CC) $(HOST_ALL_CFLAGS) -MMD -c -o $@ $<
+
+$(HOST_DIR)/%.o: %.c
+	@$(MKDIR) -p $(dir $@)
+	$(HOST_CC) $(HOST_ALL_CFLAGS) -MMD -c -o $@ $<
+	$(HOST_OBJCOPY) $(FW_SECTIONS) $@
+
+host-run: host
+	$(HOST_DIR)/buggy -t $(HOST_RUN_MS)
+
+# One result line per maze, then the totals
+host-bench: $(HOST_DIR)/sim
+	@for maze in $(HOST_MAZES); do $(HOST_DIR)/sim -s $(HOST_SEED) $$maze; done | tee $(HOST_DIR)/bench.txt
+	@awk '{for(i=1;i<=NF;i++){split($$i,kv,"="); v[kv[1]]=kv[2]} n++; home+=(v["result"]=="home"); t+=v["time_ms"]; \
+		p+=v["pos_err_mm"]; m+=v["misclass"]; r+=v["reads"]; c+=v["collisions"]} \
+		END{printf "total mazes=%d home=%d time_ms=%d mean_pos_err_mm=%.0f misclass=%d/%d collisions=%d\n",n,home,t,p/n,m,r,c}' $(HOST_DIR)/bench.txt
+
+# Labelled reads of every maze, sim -d appends so the file is started afresh
+host-dataset: $(HOST_DIR)/sim
+	@rm -f $(HOST_DATASET)
+	@for maze in $(HOST_MAZES); do $(HOST_DIR)/sim -s $(HOST_SEED) -d $(HOST_DATASET) $$maze > /dev/null; done
+	@wc -l < $(HOST_DATASET) | xargs echo reads recorded in $(HOST_DATASET):
+
+host-replay: $(HOST_DIR)/replay
+	$(HOST_DIR)/replay $(HOST_DATASET)
+
+# Fails when the RAM_LIMIT or FLASH_LIMIT of the profile is exceeded
+host-mem: $(HOST_DIR)/buggy
+	python3 host/mem_report.py --config $(HOST_DIR)/robot_config.h $(HOST_DIR)/buggy.map
+
+host-clean:
+	rm -rf build/host
+
+-include $(FIRMWARE_OBJ:.o=.d) $(HOST_OBJ:.o=.d) $(SIM_OBJ:.o=.d) $(REPLAY_OBJ:.o=.d)
+
+.PHONY: host host-run host-sim host-bench host-dataset host-replay host-mem host-clean
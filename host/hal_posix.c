@@ -0,0 +1,462 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "hal.h"
+#include "interrupts.h"
+
+struct HAL_regs hal_regs;                   // Emulated register file
+static struct HAL_i2c_device *i2c_devices[HAL_I2C_DEVICES]; // Device models attached to the I2C bus, none by default
+static int i2c_attached = 0;
+struct HAL_host_hooks hal_host;             // Host program callbacks, none by default
+
+static unsigned long run_limit_ms = 0;      // Virtual time after which the run is ended, 0 for no limit
+static unsigned long next_tick_us = 1000;   // Virtual time of the next Timer0 tick
+static unsigned long tx_free_us = 0;        // Virtual time at which TX4REG is empty again (TX4IF)
+static unsigned char i2c_hung = 0;          // Set while a device holds the I2C bus, MSSP2 then stays busy
+static unsigned char wdt_on = 0;            // Watchdog started by HAL_WDT_START()
+static unsigned long wdt_ms = 0;            // ms since the watchdog was last cleared
+static char reset_cause = RESET_POWER;      // Cause of the last reset for hal_reset_cause()
+static jmp_buf boot;                        // Restart point of a reset, set by hal_posix_boot()
+static unsigned char *fw_data_init = 0;     // Initial values of the firmware variables with one, copied at boot
+
+// Firmware variables, the sections are named by host.mk
+extern unsigned char __start_fw_data[] __attribute__((weak)), __stop_fw_data[] __attribute__((weak));
+extern unsigned char __start_fw_bss[] __attribute__((weak)), __stop_fw_bss[] __attribute__((weak));
+
+static unsigned char eeprom[EEPROM_SIZE];   // Data EEPROM contents
+static unsigned char eeprom_ready = 0;      // Set once the contents are erased or loaded
+static const char *eeprom_path = 0;         // File the EEPROM is kept in, none by default
+
+#define MAX_RX_SCHEDULE 16
+
+struct RX_schedule { //Text delivered on EUSART4 receive at a given virtual time
+    unsigned long ms;
+    char text[64];
+    int sent;       // Characters already received
+};
+
+static struct RX_schedule rx_schedule[MAX_RX_SCHEDULE];
+static int rx_scheduled = 0;
+
+#define UART_BYTE_US 521    // 10 bits at 19200 baud
+#define I2C_BYTE_US 90      // 9 bits at 100kHz
+
+/************************************
+ * Backend initialisation functions, there is no hardware to configure on the host
+ * Inputs: PWM period for hal_pwm_init(), stored so the simulator can convert duty to power
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void hal_gpio_init(void) {}
+void hal_pwm_init(int PWMperiod) {hal_regs.pwm_period = PWMperiod;}
+void hal_i2c_init(void) {}
+void hal_power_init(void) {}
+void hal_uart_init(void) {}
+void hal_timer0_init(void) {}
+void hal_timer1_init(void) {}
+void hal_interrupts_init(void) {}
+
+/************************************
+ * Functions to hold the I2C bus, e.g. a colour click glitch pulling SDA low, MSSP2 then never finishes
+ * Inputs: 1 to hold the bus, 0 to release it
+ * Outputs: MSSP2 busy for HAL_I2C_BUSY()
+ * Functions called within: None
+************************************/
+unsigned char hal_posix_i2c_busy(void)
+{
+    return i2c_hung;
+}
+
+void hal_posix_i2c_hang(unsigned char on)
+{
+    i2c_hung = on;
+}
+
+/************************************
+ * Function to attach a device model to the I2C bus
+ * Inputs: Callbacks of the device
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void hal_posix_i2c_attach(struct HAL_i2c_device *device)
+{
+    if(i2c_attached < HAL_I2C_DEVICES){i2c_devices[i2c_attached++] = device;}
+}
+
+/************************************
+ * I2C bus functions, forwarded to every attached device model
+ * Inputs: Byte to write for hal_posix_i2c_write(), acknowledge for hal_posix_i2c_ack()
+ * Outputs: Byte read for hal_posix_i2c_read(), the wired AND of the devices as on the open drain SDA line,
+ * 0xFF (bus pulled up) if no device is addressed
+ * Functions called within: The callbacks of the attached devices
+************************************/
+void hal_posix_i2c_start(void)
+{
+    int i;
+    hal_posix_advance_us(I2C_BYTE_US / 9);
+    for(i = 0; i < i2c_attached; i++){if(i2c_devices[i]->start){i2c_devices[i]->start();}}
+}
+
+void hal_posix_i2c_stop(void)
+{
+    int i;
+    for(i = 0; i < i2c_attached; i++){if(i2c_devices[i]->stop){i2c_devices[i]->stop();}}
+}
+
+void hal_posix_i2c_write(unsigned char b)
+{
+    int i;
+    hal_posix_advance_us(I2C_BYTE_US);
+    for(i = 0; i < i2c_attached; i++){if(i2c_devices[i]->write){i2c_devices[i]->write(b);}}
+}
+
+unsigned char hal_posix_i2c_read(void)
+{
+    int i;
+    unsigned char b = 0xFF;
+    hal_posix_advance_us(I2C_BYTE_US);
+    for(i = 0; i < i2c_attached; i++){if(i2c_devices[i]->read){b &= i2c_devices[i]->read();}}
+    return b;
+}
+
+void hal_posix_i2c_ack(unsigned char ack)
+{
+    (void)ack; // The device models auto-increment on every read
+}
+
+/************************************
+ * EUSART4 functions. Transmitted bytes go to the host hook or stdout, received bytes are
+ * delivered through HighISR() like the receive interrupt on the PIC. A write keeps TX4REG busy
+ * for the time of one byte, the transmit interrupt is raised once it is empty again (uart_tx_due()).
+ * Inputs: Byte to send or receive, transmit interrupt enable
+ * Outputs: Received byte for hal_posix_uart_read(), 1 if TX4REG is empty
+ * Functions called within: HighISR()
+************************************/
+unsigned char hal_posix_uart_tx_ready(void)
+{
+    return hal_regs.now_us >= tx_free_us;
+}
+
+char hal_posix_uart_read(void)
+{
+    hal_regs.rx_ready = 0; // Reading RC4REG clears RC4IF
+    return hal_regs.rx_byte;
+}
+
+void hal_posix_uart_write(char c)
+{
+    tx_free_us = ((tx_free_us > hal_regs.now_us) ? tx_free_us : hal_regs.now_us) + UART_BYTE_US;
+    if(hal_host.uart_tx){hal_host.uart_tx(c);}
+    else{putchar(c);}
+}
+
+void hal_posix_uart_tx_int(unsigned char on)
+{
+    unsigned char was = hal_regs.tx4ie;
+    hal_regs.tx4ie = on;
+    if(on && !was && hal_posix_uart_tx_ready()){HighISR();} // TX4IF already set, the interrupt is taken at once
+}
+
+/************************************
+ * Function to raise the transmit interrupt each time TX4REG empties, up to a virtual time
+ * Inputs: Virtual time in us
+ * Outputs: None
+ * Functions called within: HighISR(), which sends the next byte of the TX buffer or disables the interrupt
+************************************/
+static void uart_tx_due(unsigned long until)
+{
+    while(hal_regs.tx4ie && tx_free_us <= until)
+    {
+        if(tx_free_us > hal_regs.now_us){hal_regs.now_us = tx_free_us;}
+        HighISR();
+    }
+}
+
+void hal_posix_uart_receive(char c)
+{
+    hal_regs.rx_byte = c;
+    hal_regs.rx_ready = 1;
+    HighISR();
+}
+
+/************************************
+ * Function to deliver a falling edge on INT1 (colour click interrupt line)
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: LowISR()
+************************************/
+void hal_posix_int1(void)
+{
+    hal_regs.int1if = 1;
+    LowISR();
+}
+
+/************************************
+ * Function to deliver scheduled serial input that has become due
+ * Inputs: Current virtual time in ms
+ * Outputs: None
+ * Functions called within: hal_posix_uart_receive() for every character. The characters arrive at the
+ * line rate, 1000 / UART_BYTE_US per ms, and due entries one after the other in the order they were scheduled,
+ * so a long upload does not overrun the RX buffer of the firmware.
+************************************/
+static void deliver_rx(unsigned long now_ms)
+{
+    int i, n = 1000 / UART_BYTE_US;
+    struct RX_schedule *s;
+    for(i = 0; i < rx_scheduled && n > 0; i++)
+    {
+        s = &rx_schedule[i];
+        if(s->ms == 0){continue;} // Delivered
+        if(s->ms > now_ms){continue;}
+        while(n > 0 && s->text[s->sent])
+        {
+            hal_posix_uart_receive(s->text[s->sent++]);
+            n--;
+        }
+        if(!s->text[s->sent]){s->ms = 0;}
+    }
+}
+
+/************************************
+ * Function to schedule serial input for the firmware
+ * Inputs: "ms:text", text is received on EUSART4 at ms of virtual time (\n is a newline)
+ * Outputs: 0 on success, -1 if the spec is malformed or the schedule is full
+ * Functions called within: None
+************************************/
+int hal_posix_schedule_rx(const char *spec)
+{
+    char *end;
+    const char *c;
+    int n = 0;
+    unsigned long ms = strtoul(spec, &end, 10);
+    
+    if(end == spec || *end != ':' || ms == 0 || rx_scheduled == MAX_RX_SCHEDULE){return -1;}
+    for(c = end + 1; *c && n < (int)sizeof(rx_schedule[0].text) - 1; c++)
+    {
+        if(c[0] == '\\' && c[1] == 'n'){rx_schedule[rx_scheduled].text[n++] = '\n'; c++;}
+        else{rx_schedule[rx_scheduled].text[n++] = *c;}
+    }
+    rx_schedule[rx_scheduled].text[n] = 0;
+    rx_schedule[rx_scheduled].ms = ms;
+    rx_scheduled++;
+    return 0;
+}
+
+/************************************
+ * Function to advance virtual time
+ * Inputs: Number of microseconds
+ * Outputs: None
+ * Functions called within: LowISR() for every Timer0 tick crossed and the host tick hook.
+ * The process exits once the run limit set by hal_posix_run() is reached.
+************************************/
+void hal_posix_advance_us(unsigned long us)
+{
+    unsigned long target = hal_regs.now_us + us;
+    
+    while(1)
+    {
+        uart_tx_due((next_tick_us <= target) ? next_tick_us : target);
+        if(next_tick_us > target){break;}
+        hal_regs.now_us = next_tick_us;
+        next_tick_us += 1000;
+        hal_regs.tmr0if = 1;
+        LowISR();
+        deliver_rx(hal_regs.now_us / 1000);
+        if(hal_host.tick){hal_host.tick(hal_regs.now_us / 1000);}
+        if(wdt_on && ++wdt_ms >= HAL_WDT_MS){hal_posix_reset(RESET_WDT);}
+        if(run_limit_ms && hal_regs.now_us / 1000 >= run_limit_ms)
+        {
+            fflush(stdout);
+            exit(0);
+        }
+    }
+    hal_regs.now_us = target;
+}
+
+/************************************
+ * Function to advance virtual time, replaces __delay_ms()
+ * Inputs: Number of milliseconds
+ * Outputs: None
+ * Functions called within: hal_posix_advance_us()
+************************************/
+void hal_posix_delay_ms(unsigned long ms)
+{
+    hal_posix_advance_us(ms * 1000);
+}
+
+/************************************
+ * Function to wait in Idle mode, replaces SLEEP
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: hal_posix_advance_us() up to the next Timer0 tick, or up to the transmit interrupt
+ * if it comes first. UART receive and the colour click interrupt are raised on ticks, so no other interrupt
+ * wakes the core earlier.
+************************************/
+void hal_posix_idle(void)
+{
+    unsigned long wake = next_tick_us;
+    if(hal_regs.tx4ie && tx_free_us < wake){wake = (tx_free_us > hal_regs.now_us) ? tx_free_us : hal_regs.now_us;}
+    hal_posix_advance_us(wake - hal_regs.now_us);
+}
+
+/************************************
+ * Function to read the Timer0 count within the current ms
+ * Inputs: None
+ * Outputs: Count in 4us steps, 0 to 249
+ * Functions called within: hal_posix_advance_us() by 1us, the read takes time on the target too
+ * and loops polling the count would otherwise never end.
+************************************/
+unsigned char hal_posix_tmr0_count(void)
+{
+    hal_posix_advance_us(1);
+    return (unsigned char)((hal_regs.now_us % 1000) / 4);
+}
+
+/************************************
+ * Function to forward a HAL_PROBE() event from the firmware to the host program
+ * Inputs: Event (PROBE_ defines in hal.h) and its value
+ * Outputs: None
+ * Functions called within: The host probe hook
+************************************/
+void hal_posix_probe(int event, int value)
+{
+    if(hal_host.probe){hal_host.probe(event, value);}
+}
+
+/************************************
+ * Function to read the virtual time
+ * Inputs: None
+ * Outputs: Milliseconds since the start of the run
+ * Functions called within: None
+************************************/
+unsigned long hal_posix_ms(void)
+{
+    return hal_regs.now_us / 1000;
+}
+
+/************************************
+ * Function to set the virtual run time after which the firmware is stopped
+ * Inputs: Limit in ms, 0 to run forever
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void hal_posix_run(unsigned long limit_ms)
+{
+    run_limit_ms = limit_ms;
+}
+
+/************************************
+ * Watchdog functions, HAL_WDT_START() and HAL_WDT_CLEAR()
+ * Inputs: 1 to start the watchdog, 0 to clear it
+ * Outputs: None
+ * Functions called within: None, hal_posix_advance_us() resets the firmware once HAL_WDT_MS pass without a clear
+************************************/
+void hal_posix_wdt(unsigned char start)
+{
+    if(start){wdt_on = 1;}
+    wdt_ms = 0;
+}
+
+/************************************
+ * Function to reset the firmware, HAL_RESET() and watchdog timeouts
+ * Inputs: Cause of the reset (RESET_ codes of hal.h)
+ * Outputs: None, continues in hal_posix_boot()
+ * Functions called within: None
+ * The registers are cleared like on the PIC (motors off, interrupts disabled), hal_posix_boot() then sets the
+ * variables back.
+************************************/
+void hal_posix_reset(char cause)
+{
+    unsigned long now_us = hal_regs.now_us;
+    memset(&hal_regs, 0, sizeof(hal_regs));
+    hal_regs.now_us = now_us;
+    reset_cause = cause;
+    wdt_on = 0;
+    wdt_ms = 0;
+    longjmp(boot, 1);
+}
+
+/************************************
+ * Function to run the firmware from power on, and again after every reset
+ * Inputs: main() of the firmware
+ * Outputs: None, never returns
+ * Functions called within: The firmware main. After a reset the firmware variables are set back to their
+ * initial values and the rest cleared as by the XC8 startup code, only __persistent variables keep their values.
+************************************/
+void hal_posix_boot(void (*entry)(void))
+{
+    size_t data = __stop_fw_data - __start_fw_data, bss = __stop_fw_bss - __start_fw_bss;
+    if(!fw_data_init && data)
+    {
+        fw_data_init = malloc(data);
+        memcpy(fw_data_init, __start_fw_data, data);
+    }
+    if(setjmp(boot))
+    {
+        if(data){memcpy(__start_fw_data, fw_data_init, data);}
+        if(bss){memset(__start_fw_bss, 0, bss);}
+    }
+    entry();
+}
+
+/************************************
+ * Function to find the cause of the last reset
+ * Inputs: None
+ * Outputs: RESET_POWER for the first boot, the cause given to hal_posix_reset() after that
+ * Functions called within: None
+************************************/
+char hal_reset_cause(void)
+{
+    return reset_cause;
+}
+
+/************************************
+ * Data EEPROM functions. The contents start erased (0xFF) unless a file was given with
+ * hal_posix_eeprom_file(), which is then rewritten on every write so settings persist between runs.
+ * Inputs: Address and the byte to store
+ * Outputs: The byte stored at the address for hal_eeprom_read()
+ * Functions called within: None
+************************************/
+static void eeprom_init(void)
+{
+    if(eeprom_ready){return;}
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    eeprom_ready = 1;
+}
+
+unsigned char hal_eeprom_read(unsigned int addr)
+{
+    eeprom_init();
+    return eeprom[addr % EEPROM_SIZE];
+}
+
+void hal_eeprom_write(unsigned int addr, unsigned char value)
+{
+    FILE *f;
+    eeprom_init();
+    eeprom[addr % EEPROM_SIZE] = value;
+    hal_posix_advance_us(4000); // Erase and write time of a byte
+    if(!eeprom_path){return;}
+    f = fopen(eeprom_path, "wb");
+    if(!f){perror(eeprom_path); return;}
+    fwrite(eeprom, 1, sizeof(eeprom), f);
+    fclose(f);
+}
+
+/************************************
+ * Function to keep the data EEPROM in a file
+ * Inputs: Path of the file, loaded now if it exists and rewritten by every hal_eeprom_write()
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void hal_posix_eeprom_file(const char *path)
+{
+    FILE *f;
+    eeprom_init();
+    eeprom_path = path;
+    f = fopen(path, "rb");
+    if(!f){return;} // Starts erased, created on the first write
+    if(fread(eeprom, 1, sizeof(eeprom), f) != sizeof(eeprom)){memset(eeprom, 0xFF, sizeof(eeprom));}
+    fclose(f);
+}
@@ -0,0 +1,141 @@
+#ifndef _hal_posix_H
+#define _hal_posix_H
+
+/************************************
+ * POSIX backend of the hardware abstraction layer
+ * The PIC registers used by the firmware are replaced by fields of hal_regs. Time is virtual:
+ * HAL_DELAY_MS() advances the clock and raises the Timer0 tick through LowISR() exactly as the
+ * PIC would, so the firmware runs at host speed. Blocking I2C byte transfers also advance the clock
+ * by their transfer time (100kHz) and a UART byte keeps TX4REG busy for its time (19200 baud), so loop
+ * periods match the target, and HAL_IDLE() skips to the next Timer0 tick, the latest interrupt that
+ * wakes the PIC, or to the transmit interrupt.
+ * The watchdog runs on virtual time, and a reset restarts the firmware from hal_posix_boot() with
+ * the registers cleared and the variables back at their initial values, as the XC8 startup code does,
+ * except those declared __persistent (host.mk moves the firmware variables to sections of their own).
+ * I2C transactions are forwarded to an attached device model (e.g. the TCS3471 of the simulator).
+************************************/
+
+#define __interrupt(priority)   // ISRs are plain functions called by the backend
+#define __persistent __attribute__((section("fw_persistent"))) // Kept through a reset, not in fw_data or fw_bss
+
+struct HAL_regs { //Emulated register file
+    unsigned char beam, brake, turn_l, turn_r, headlamps; // buggy LEDs
+    unsigned char led_red, led_green, led_blue, debug;    // colour click RGB LED and clicker 2 LED
+    unsigned char pwm6dch, pwm7dch;   // motor PWM duty
+    unsigned char late, latg;         // motor direction LATs
+    unsigned char int1if, tmr0if, ssp2if; // interrupt flags
+    unsigned char tx4ie;              // transmit interrupt enable
+    unsigned char rx_ready, rx_byte;  // pending received byte
+    int pwm_period;                   // Timer2 period set by hal_pwm_init
+    unsigned long now_us;             // virtual time
+};
+
+struct HAL_i2c_device { //Callbacks of a device model attached to the I2C bus, every device sees every transfer
+    void (*start)(void);
+    void (*write)(unsigned char b);
+    unsigned char (*read)(void);    // 0xFF (released) unless the device is addressed
+    void (*stop)(void);
+};
+
+#define HAL_I2C_DEVICES 4   // Device models that can share the bus
+
+struct HAL_host_hooks { //Callbacks of a host program driving the firmware (e.g. the simulator)
+    void (*tick)(unsigned long now_ms);    // called every virtual millisecond
+    void (*uart_tx)(char c);               // called for every byte sent on EUSART4
+    void (*probe)(int event, int value);   // called by HAL_PROBE() in the firmware
+};
+
+extern struct HAL_regs hal_regs;
+extern struct HAL_host_hooks hal_host;
+
+// GPIO
+#define PIN_BEAM        hal_regs.beam
+#define PIN_BRAKE       hal_regs.brake
+#define PIN_TURN_L      hal_regs.turn_l
+#define PIN_TURN_R      hal_regs.turn_r
+#define PIN_HEADLAMPS   hal_regs.headlamps
+#define PIN_LED_RED     hal_regs.led_red
+#define PIN_LED_GREEN   hal_regs.led_green
+#define PIN_LED_BLUE    hal_regs.led_blue
+#define PIN_DEBUG       hal_regs.debug
+
+#define HAL_GPIO_WRITE(pin, value) ((pin) = (value))
+#define HAL_GPIO_READ(pin)         (pin)
+#define HAL_GPIO_TOGGLE(pin)       ((pin) = !(pin))
+
+// PWM
+#define HAL_MOTOR_L_DUTY    hal_regs.pwm6dch
+#define HAL_MOTOR_L_DIR_LAT hal_regs.late
+#define HAL_MOTOR_L_DIR_PIN 4
+#define HAL_MOTOR_R_DUTY    hal_regs.pwm7dch
+#define HAL_MOTOR_R_DIR_LAT hal_regs.latg
+#define HAL_MOTOR_R_DIR_PIN 6
+
+// I2C
+#define HAL_I2C_BUSY()      hal_posix_i2c_busy()
+#define HAL_I2C_START()     hal_posix_i2c_start()
+#define HAL_I2C_RESTART()   hal_posix_i2c_start()
+#define HAL_I2C_STOP()      hal_posix_i2c_stop()
+#define HAL_I2C_WRITE(b)    hal_posix_i2c_write(b)
+#define HAL_I2C_RECEIVE()   ((void)0)
+#define HAL_I2C_READ()      hal_posix_i2c_read()
+#define HAL_I2C_ACK(ack)    hal_posix_i2c_ack(ack)
+
+// EUSART4
+#define HAL_UART_RX_READY()     (hal_regs.rx_ready)
+#define HAL_UART_READ()         hal_posix_uart_read()
+#define HAL_UART_TX_READY()     hal_posix_uart_tx_ready()
+#define HAL_UART_WRITE(c)       hal_posix_uart_write(c)
+#define HAL_UART_TX_INT(on)     hal_posix_uart_tx_int(on)
+
+// Interrupt flags
+#define HAL_INT1_FLAG   hal_regs.int1if
+#define HAL_TMR0_FLAG   hal_regs.tmr0if
+#define HAL_I2C_FLAG    hal_regs.ssp2if
+#define HAL_INTERRUPTS(on)  ((void)0)   // Interrupts are only raised between firmware statements
+
+// Timers and delays
+#define HAL_TMR1_READ()     ((unsigned int)((hal_regs.now_us * 2) & 0xFFFF))
+#define HAL_TMR0_COUNT()    hal_posix_tmr0_count()
+#define HAL_DELAY_MS(x)     hal_posix_delay_ms(x)
+
+// Power
+#define HAL_IDLE()          hal_posix_idle()
+
+// Watchdog and reset, a reset restarts the firmware from hal_posix_boot()
+#define HAL_WDT_START()     hal_posix_wdt(1)
+#define HAL_WDT_CLEAR()     hal_posix_wdt(0)
+#define HAL_RESET()         hal_posix_reset(RESET_SOFT)
+
+// Host instrumentation hook
+#define HAL_PROBE(event, value) hal_posix_probe(event, value)
+
+//function prototypes (Function descriptions are to be found in the .c file)
+unsigned char hal_posix_i2c_busy(void);
+void hal_posix_i2c_hang(unsigned char on);
+void hal_posix_i2c_attach(struct HAL_i2c_device *device);
+void hal_posix_i2c_start(void);
+void hal_posix_i2c_stop(void);
+void hal_posix_i2c_write(unsigned char b);
+unsigned char hal_posix_i2c_read(void);
+void hal_posix_i2c_ack(unsigned char ack);
+unsigned char hal_posix_uart_tx_ready(void);
+char hal_posix_uart_read(void);
+void hal_posix_uart_write(char c);
+void hal_posix_uart_tx_int(unsigned char on);
+void hal_posix_uart_receive(char c);
+void hal_posix_int1(void);
+void hal_posix_delay_ms(unsigned long ms);
+void hal_posix_advance_us(unsigned long us);
+void hal_posix_idle(void);
+unsigned char hal_posix_tmr0_count(void);
+void hal_posix_probe(int event, int value);
+unsigned long hal_posix_ms(void);
+void hal_posix_run(unsigned long limit_ms);
+int hal_posix_schedule_rx(const char *spec);
+void hal_posix_eeprom_file(const char *path);
+void hal_posix_wdt(unsigned char start);
+void hal_posix_reset(char cause);
+void hal_posix_boot(void (*entry)(void));
+
+#endif
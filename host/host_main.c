@@ -0,0 +1,34 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hal.h"
+
+void firmware_main(void); // main() of main.c, renamed for the host build
+
+/************************************
+ * Entry point of the host build, runs the unmodified firmware against the POSIX backend
+ * Usage: buggy [-t run_ms] [-e eeprom_file] [-r ms:text]...
+ * -e keeps the data EEPROM in a file, so calibrations persist between runs
+ * -r delivers text on the serial receive line at the given virtual time, e.g. -r 5000:T for a trace dump
+ * Serial output of the firmware is written to stdout.
+************************************/
+int main(int argc, char **argv)
+{
+    int i;
+    unsigned long limit = 60000; // One minute of virtual time by default
+    
+    for(i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-t") == 0 && i + 1 < argc){limit = strtoul(argv[++i], 0, 10);}
+        else if(strcmp(argv[i], "-e") == 0 && i + 1 < argc){hal_posix_eeprom_file(argv[++i]);}
+        else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc && hal_posix_schedule_rx(argv[i + 1]) == 0){i++;}
+        else
+        {
+            fprintf(stderr, "usage: %s [-t run_ms] [-e eeprom_file] [-r ms:text]...\n", argv[0]);
+            return 2;
+        }
+    }
+    hal_posix_run(limit);
+    hal_posix_boot(firmware_main); // Never returns, hal_posix_delay_ms() exits at the run limit
+    return 0;
+}
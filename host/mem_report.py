@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""Per-module RAM and flash budget of a firmware build, from its linker map.
+
+Reads the XC8 map of the PIC build (psects per module, space 0 program memory, space 1 data memory)
+or the GNU ld map of the host build (-Wl,-Map), which overestimates the PIC figures (32 bit ints,
+x86 code) but tracks the same changes. host.mk renames the sections of the firmware variables to fw_data and
+fw_bss, __persistent variables are in fw_persistent. Only firmware modules are listed, the XC8 runtime and library
+psects are counted as "(library)". With --config the RAM_LIMIT and FLASH_LIMIT of the robot profile
+(robot_config.h) are checked, and the exit status is 1 when a total is over its limit.
+
+usage: mem_report.py [--config robot_config.h] map_file
+"""
+import os
+import re
+import sys
+
+HOST_SKIP = (".debug", ".eh_frame", ".comment", ".note", ".gnu", ".init_array", ".fini_array")
+
+
+def module_name(path):
+    return os.path.splitext(os.path.basename(path))[0]
+
+
+def parse_gnu(lines):
+    """Returns {module: [ram, flash]} from a GNU ld map, host/ objects and libraries excluded"""
+    modules, pending, started = {}, None, False
+    for line in lines:
+        if line.startswith("Linker script and memory map"):
+            started = True
+            continue
+        if not started:
+            continue
+        m = re.match(r"^ (\.\S+|COMMON|fw_\w+)\s*$", line)
+        if m: # Long section name, the address and size follow on the next line
+            pending = m.group(1)
+            continue
+        m = re.match(r"^ (\.\S+|COMMON|fw_\w+)\s+0x[0-9a-f]+\s+0x([0-9a-f]+)\s+(\S+\.o)$", line)
+        if m:
+            section, size, path = m.group(1), int(m.group(2), 16), m.group(3)
+        else:
+            m = re.match(r"^\s+0x[0-9a-f]+\s+0x([0-9a-f]+)\s+(\S+\.o)$", line)
+            if not m or pending is None:
+                pending = None
+                continue
+            section, size, path = pending, int(m.group(1), 16), m.group(2)
+        pending = None
+        if path.startswith("/") or os.path.basename(os.path.dirname(path)) == "host" or section.startswith(HOST_SKIP):
+            continue
+        ram_flash = modules.setdefault(module_name(path), [0, 0])
+        if section.startswith((".bss", "COMMON", "fw_bss", "fw_persistent")):
+            ram_flash[0] += size
+        elif section.startswith((".data", "fw_data")):
+            ram_flash[0] += size
+            ram_flash[1] += size # Initial values are copied from flash
+        elif section.startswith((".text", ".rodata")):
+            ram_flash[1] += size
+    return modules
+
+
+def parse_xc8(lines):
+    """Returns {module: [ram, flash]} from the psect table of an XC8 map"""
+    modules, module, started = {}, "(library)", False
+    for line in lines:
+        words = line.split()
+        if words[:6] == ["Name", "Link", "Load", "Length", "Selector", "Space"]:
+            started = True
+            continue
+        if not started:
+            continue
+        if line.startswith(("UNUSED ADDRESS RANGES", "Symbol Table")):
+            break
+        if words and re.search(r"\.(p1|obj|o)$", words[0]):
+            module = module_name(words[0])
+            words = words[1:]
+        if len(words) < 6:
+            continue
+        try:
+            length, space = int(words[3], 16), int(words[5])
+            int(words[1], 16), int(words[2], 16)
+        except ValueError:
+            continue
+        ram_flash = modules.setdefault(module, [0, 0])
+        if space == 1:
+            ram_flash[0] += length
+        elif space == 0:
+            ram_flash[1] += length
+    return modules
+
+
+def limits(path):
+    found = {}
+    with open(path) as f:
+        for line in f:
+            m = re.match(r"#define\s+(RAM_LIMIT|FLASH_LIMIT)\s+(\d+)", line)
+            if m:
+                found[m.group(1)] = int(m.group(2))
+    return found.get("RAM_LIMIT"), found.get("FLASH_LIMIT")
+
+
+def main():
+    args = sys.argv[1:]
+    config = None
+    if len(args) == 3 and args[0] == "--config":
+        config, args = args[1], args[2:]
+    if len(args) != 1:
+        sys.exit(__doc__.strip().splitlines()[-1])
+    with open(args[0]) as f:
+        lines = f.read().splitlines()
+    gnu = any(line.startswith("Linker script and memory map") for line in lines)
+    modules = parse_gnu(lines) if gnu else parse_xc8(lines)
+    ram_limit, flash_limit = limits(config) if config else (None, None)
+
+    print("%-12s %8s %8s" % ("module", "ram", "flash"))
+    for name in sorted(modules, key=lambda n: -modules[n][0]):
+        print("%-12s %8d %8d" % (name, modules[name][0], modules[name][1]))
+    ram = sum(v[0] for v in modules.values())
+    flash = sum(v[1] for v in modules.values())
+    print("%-12s %8d %8d" % ("total", ram, flash))
+    over = False
+    for what, total, limit in (("ram", ram, ram_limit), ("flash", flash, flash_limit)):
+        if limit is None:
+            continue
+        print("%s %d of %d bytes (%.0f%%)" % (what, total, limit, 100.0 * total / limit))
+        if total > limit:
+            print("%s budget exceeded by %d bytes" % (what, total - limit), file=sys.stderr)
+            over = True
+    sys.exit(1 if over else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,80 @@
+#include "hal.h"
+#include "mpu6050_model.h"
+
+#define REG_GYRO_CONFIG 0x1B    // FS_SEL bits 4:3
+#define REG_GYRO_ZOUT_H 0x47    // High byte first, GYRO_ZOUT_L at 0x48
+#define REG_PWR_MGMT_1  0x6B    // SLEEP bit 6, set at power up
+#define REG_WHO_AM_I    0x75
+
+static unsigned char regs[0x80];        // Register file
+static unsigned char pointer;           // Register addressed by the last write
+static unsigned char state;             // 0 expecting address, 1 expecting register, 2 data, 3 other device
+static unsigned char reading;           // Read transaction in progress
+
+static void bus_start(void) {state = 0;}
+static void bus_stop(void) {state = 0;}
+
+/************************************
+ * I2C write callback, address byte, then register address, then register data with auto increment
+************************************/
+static void bus_write(unsigned char b)
+{
+    if(state == 0) // Address byte
+    {
+        reading = (b & 0x01);
+        state = ((b & 0xFE) == MPU6050_ADDR) ? (reading ? 2 : 1) : 3;
+        return;
+    }
+    if(state == 1) // Register address
+    {
+        pointer = b & 0x7F;
+        state = 2;
+        return;
+    }
+    if(state == 2 && !reading) // Register data
+    {
+        regs[pointer & 0x7F] = b;
+        pointer++;
+    }
+}
+
+/************************************
+ * I2C read callback, returns the addressed register and moves on to the next
+************************************/
+static unsigned char bus_read(void)
+{
+    if(state != 2 || !reading){return 0xFF;}
+    return regs[pointer++ & 0x7F];
+}
+
+static struct HAL_i2c_device mpu6050_device = {bus_start, bus_write, bus_read, bus_stop};
+
+/************************************
+ * Function to attach the model to the POSIX I2C bus, in its power up state
+ * Inputs: None
+ * Outputs: None
+************************************/
+void mpu6050_attach(void)
+{
+    regs[REG_WHO_AM_I] = 0x68;
+    regs[REG_PWR_MGMT_1] = 0x40; // Asleep until the firmware wakes it
+    hal_posix_i2c_attach(&mpu6050_device);
+}
+
+/************************************
+ * Function to latch a new gyro sample, called from the host tick
+ * Inputs: Yaw rate in degrees per second, counterclockwise positive
+ * Outputs: None
+************************************/
+void mpu6050_sample(double yaw_dps)
+{
+    static const double lsb_per_dps[4] = {131, 65.5, 32.8, 16.4}; // FS_SEL 250, 500, 1000, 2000 dps
+    double v = yaw_dps * lsb_per_dps[(regs[REG_GYRO_CONFIG] >> 3) & 3];
+    int z;
+    if(regs[REG_PWR_MGMT_1] & 0x40){v = 0;} // Asleep
+    if(v > 32767){v = 32767;}
+    if(v < -32768){v = -32768;}
+    z = (int)v;
+    regs[REG_GYRO_ZOUT_H] = (z >> 8) & 0xFF;
+    regs[REG_GYRO_ZOUT_H + 1] = z & 0xFF;
+}
@@ -0,0 +1,17 @@
+#ifndef _mpu6050_model_H
+#define _mpu6050_model_H
+
+/************************************
+ * Register level model of the gyro of an MPU-6050 IMU, attached to the POSIX I2C bus next to the 
+ * TCS3471 model. The yaw rate of the robot model, plus a bias and noise, is latched into GYRO_ZOUT
+ * at every sample, scaled for the full scale range set in GYRO_CONFIG. The accelerometer and the
+ * other two gyro axes read 0.
+************************************/
+
+#define MPU6050_ADDR 0xD0   // 7 bit address 0x68 shifted left, as used by the firmware
+
+//function prototypes (Function descriptions are to be found in the .c file)
+void mpu6050_attach(void);
+void mpu6050_sample(double yaw_dps);
+
+#endif
@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hal.h"
+#include "color.h"
+#include "record.h"
+
+/************************************
+ * Offline replay of recorded colour reads through the classifier of this build
+ * Every labelled read of the datasets is run through calibrate_RGB(), RGB_to_Hue() and classify_RGB()
+ * with the calibration of the robot profile, and scored against its label. Prints the accuracy,
+ * the confusion matrix, the number of reads whose decision differs from the one recorded on the buggy
+ * and the compute cost per read on the host (the cost on the target is in the trace, see trace.h).
+ * Usage: replay [-v] [-c min_clear] dataset_file...
+ * Dataset lines are "R<source> <decision> <C> <R> <G> <B> <label>", the record_dump() output with the card
+ * that was in front of the sensor appended (sim -d writes them), '-' or no label for no card.
+ * Stream reads darker than COLOR_STREAM_C are not scored as the buggy does not classify them,
+ * -c scores every read from min_clear up instead. -v lists every misclassified read.
+************************************/
+
+#define MAX_SAMPLES 20000
+#define REPEAT 200 // Runs per read for the cost measurement
+
+static const char CODES[] = "WbRGBYPOK"; // Card codes of classify_RGB()
+#define N_CODES (sizeof(CODES) - 1)
+
+struct Sample { //One recorded colour read
+    unsigned int c, r, g, b;
+    char source, decision, label;
+};
+
+static struct Sample samples[MAX_SAMPLES];
+static int n_samples = 0;
+
+/************************************
+ * Function to load a dataset
+ * Inputs: Path of the file
+ * Outputs: None, lines that are not reads are skipped
+************************************/
+static void load(const char *path)
+{
+    char line[128];
+    struct Sample s;
+    FILE *f = fopen(path, "r");
+    if(!f){perror(path); exit(2);}
+    while(fgets(line, sizeof(line), f))
+    {
+        s.label = 0;
+        if(sscanf(line, "R%c %c %u %u %u %u %c", &s.source, &s.decision, &s.c, &s.r, &s.g, &s.b, &s.label) < 6){continue;}
+        if(s.label == '-'){s.label = 0;}
+        if(n_samples == MAX_SAMPLES){fprintf(stderr, "%s: too many reads\n", path); exit(2);}
+        samples[n_samples++] = s;
+    }
+    fclose(f);
+}
+
+/************************************
+ * Function to run the classifier of this build on a read
+ * Inputs: Recorded read, number of stages to run (1 calibrate, 2 and hue, 3 and classify)
+ * Outputs: Card code after all 3 stages
+************************************/
+static char classify(const struct Sample *s, int stages)
+{
+    struct RGB_val rgb;
+    struct RGB_norm n;
+
+    rgb.C = s->c;
+    rgb.R = s->r;
+    rgb.G = s->g;
+    rgb.B = s->b;
+    if(s->source == RECORD_SPECTRAL){calibrate_spectral(&rgb, &n);}
+    else{calibrate_RGB(&rgb, &n);}
+    if(stages < 2){return 0;}
+    RGB_to_Hue(&n);
+    if(stages < 3){return 0;}
+    return classify_RGB(&n);
+}
+
+/************************************
+ * Function to measure the host time per read of the first stages of the classifier
+ * Inputs: Number of stages as for classify()
+ * Outputs: ns per read
+************************************/
+static double cost(int stages)
+{
+    struct timespec t0, t1;
+    volatile char sink = 0; // Keeps the calls from being optimised away
+    int i, j;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(j = 0; j < REPEAT; j++)
+    {
+        for(i = 0; i < n_samples; i++){sink += classify(&samples[i], stages);}
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    (void)sink;
+    return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / REPEAT / n_samples;
+}
+
+static int code_index(char card)
+{
+    const char *p = card ? strchr(CODES, card) : 0;
+    return p ? (int)(p - CODES) : -1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, k, verbose = 0, scored = 0, correct = 0, changed = 0;
+    long min_clear = -1;
+    int confusion[N_CODES][N_CODES + 1]; // Last column: codes outside CODES
+    double ns[3];
+
+    for(i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+        if(strcmp(argv[i], "-v") == 0){verbose = 1;}
+        else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc){min_clear = strtol(argv[++i], 0, 10);}
+        else{break;}
+    }
+    if(i == argc || argv[i][0] == '-')
+    {
+        fprintf(stderr, "usage: %s [-v] [-c min_clear] dataset_file...\n", argv[0]);
+        return 2;
+    }
+    for(; i < argc; i++){load(argv[i]);}
+    memset(confusion, 0, sizeof(confusion));
+
+    for(i = 0; i < n_samples; i++)
+    {
+        struct Sample *s = &samples[i];
+        char card;
+        if(min_clear >= 0 ? (long)s->c < min_clear : (s->source == 'S' && s->c < COLOR_STREAM_C)){continue;}
+        card = classify(s, 3);
+        if(card != s->decision){changed++;}
+        if(!s->label || code_index(s->label) < 0){continue;}
+        scored++;
+        k = code_index(card);
+        confusion[code_index(s->label)][k < 0 ? (int)N_CODES : k]++;
+        if(card == s->label){correct++;}
+        else if(verbose){printf("R%c C=%u R=%u G=%u B=%u label %c classified %c\n", s->source, s->c, s->r, s->g, s->b, s->label, card);}
+    }
+
+    printf("profile=%s reads=%d scored=%d accuracy=%.1f%% changed=%d\n", ROBOT_PROFILE, n_samples, scored,
+        scored ? 100.0 * correct / scored : 0.0, changed);
+    printf("confusion (rows label, columns classified)\n   ");
+    for(k = 0; k < (int)N_CODES; k++){printf(" %5c", CODES[k]);}
+    printf(" other\n");
+    for(j = 0; j < (int)N_CODES; j++)
+    {
+        printf("%c  ", CODES[j]);
+        for(k = 0; k <= (int)N_CODES; k++){printf(" %5d", confusion[j][k]);}
+        printf("\n");
+    }
+    if(n_samples) // Cost over every read, scored or not
+    {
+        for(k = 0; k < 3; k++){ns[k] = cost(k + 1);}
+        printf("host cost per read: calibrate=%.0fns hue=%.0fns classify=%.0fns\n", ns[0], ns[1] - ns[0], ns[2] - ns[1]);
+    }
+    return 0;
+}
@@ -0,0 +1,404 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "hal.h"
+#include "record.h"
+#include "tcs3471_model.h"
+#include "mpu6050_model.h"
+
+/************************************
+ * Maze simulator of the buggy
+ * Runs the unmodified firmware on the POSIX backend against a differential drive model driven by
+ * the PWM duty and direction registers written in setMotorPWM(), a TCS3471 model that sees 
+ * the card or wall in front of the colour click and an MPU-6050 gyro on the same bus ("param gyro 0"
+ * takes it off, for timed turns). Prints one result line per run:
+ *   maze=<file> result=<home|aborted|timeout> time_ms= pos_err_mm= heading_err_deg= reads= misclass= collisions=
+ * Usage: sim [-v] [-t limit_ms] [-s seed] [-e eeprom_file] [-d dataset_file] [-r ms:text]... maze_file
+ * -r delivers text on the serial receive line at the given virtual time, -v shows the serial output
+ * -e keeps the data EEPROM in a file, e.g. to run with the motor curves of a calibrated buggy
+ * -d appends every colour read of the recorder, labelled with the card in front of the sensor, to a dataset for replay
+************************************/
+
+void firmware_main(void); // main() of main.c, renamed for the host build
+
+#define MAX_WALLS 128
+#define PI 3.14159265358979
+
+struct Colour { //Card colours and the calibrated RGB the firmware sees at the reference distance, chosen inside the classify_RGB() thresholds
+    const char *name;
+    char code;          // Card code returned by classify_RGB()
+    double r, g, b;     // Calibrated RGB (0-255) at the reference distance
+    double clear;       // Clear counts at the reference distance, cards are similarly bright and walls dull
+};
+
+static const struct Colour colours[] = {
+    {"black",     'K',   5,   5,   5, 1100},
+    {"red",       'R', 250,  10,  15, 1480},
+    {"green",     'G',  60, 200, 120, 1480},
+    {"blue",      'B',  60, 150, 160, 1480},
+    {"yellow",    'Y', 250, 200,  60, 1480},
+    {"pink",      'P', 255, 120, 150, 1480},
+    {"orange",    'O', 110,  10,  15, 1480},
+    {"lightblue", 'b', 120, 132, 135, 1480},
+    {"white",     'W', 247, 240, 230, 1500},
+};
+#define N_COLOURS (sizeof(colours) / sizeof(colours[0]))
+
+struct Wall { //Wall segment in mm with the colour of its surface
+    double x1, y1, x2, y2;
+    int colour;
+};
+
+struct Params { //Robot and sensor model, can be overridden with "param" lines in the maze file
+    double vmax;        // wheel speed at 100% power, mm/s
+    double deadband;    // power below which a wheel does not turn, %
+    double wheelbase;   // mm
+    double sensor;      // sensor distance in front of the axle, mm
+    double dref;        // card distance at which the colour table above is calibrated, mm
+    double d0;          // optical offset of the inverse square fall off, mm
+    double ambient;     // ambient counts per channel
+    double noise;       // relative sensor noise
+    double gain_l;      // left motor speed relative to the model, mismatched motors make the buggy drift
+    double gain_r;      // right motor speed relative to the model
+    double i2c_hang;    // virtual ms from which the colour click holds the I2C bus (fault injection), 0 for never
+    double crosstalk;   // share of the light of each LED colour seen by each of the other two colour channels
+    double gyro;        // 1 with the gyro on the I2C bus, 0 without
+    double gyro_bias;   // gyro zero rate offset, degrees/s
+    double gyro_noise;  // gyro noise amplitude, degrees/s
+};
+
+static struct Params P = {300, 30, 86, 60, 62, 250, 20, 0.01, 1, 1, 0, 0.1, 1, 1.5, 0.5};
+static struct Wall walls[MAX_WALLS];
+static int n_walls = 0;
+static double x, y, th;             // Pose of the axle centre, heading in radians
+static double sx, sy, sth;          // Start pose
+static int verbose = 0;
+static FILE *dataset = 0;           // Labelled colour reads for host/replay.c
+static char dataset_label = 0;      // Card in front of the sensor at the last recorded read, 0 if none yet
+static const char *maze_name;
+static unsigned long rng = 1;
+static unsigned long gyro_rng = 1;  // Separate sequence, the colour noise does not depend on the gyro
+
+// Run metrics
+static int reads = 0, misclass = 0, collisions = 0, in_contact = 0;
+static int retrace_done = 0, aborted = 0;
+static unsigned long end_ms = 0;
+static int record_sent = 0;         // The RS performance record of the run has been sent (perf.h)
+
+// White and black raw calibration values of the robot profile, used to turn the colour table into counts
+static const double W_RAW[3] = {CAL_WHITE_R, CAL_WHITE_G, CAL_WHITE_B};
+static const double B_RAW[3] = {CAL_BLACK_R, CAL_BLACK_G, CAL_BLACK_B};
+
+/************************************
+ * Deterministic noise source, uniform in [-1, 1]
+************************************/
+static double noise_from(unsigned long *state)
+{
+    *state = *state * 1103515245UL + 12345UL;
+    return ((double)((*state >> 16) & 0x7FFF) / 16383.5) - 1.0;
+}
+
+static double noise(void)
+{
+    return noise_from(&rng);
+}
+
+/************************************
+ * Function to find the nearest wall along a ray
+ * Inputs: Ray origin and direction
+ * Outputs: Distance to the hit in mm (HUGE_VAL if none), colour index of the hit wall
+************************************/
+static double raycast(double ox, double oy, double a, int *colour)
+{
+    double dx = cos(a), dy = sin(a), best = HUGE_VAL;
+    int i;
+    for(i = 0; i < n_walls; i++)
+    {
+        double ex = walls[i].x2 - walls[i].x1, ey = walls[i].y2 - walls[i].y1;
+        double den = dx * ey - dy * ex;
+        double t, u;
+        if(fabs(den) < 1e-9){continue;}
+        t = ((walls[i].x1 - ox) * ey - (walls[i].y1 - oy) * ex) / den;
+        u = ((walls[i].x1 - ox) * dy - (walls[i].y1 - oy) * dx) / den;
+        if(t >= 0 && u >= 0 && u <= 1 && t < best)
+        {
+            best = t;
+            *colour = walls[i].colour;
+        }
+    }
+    return best;
+}
+
+/************************************
+ * TCS3471 sampling function, RGBC counts of the surface in front of the sensor
+ * Counts follow an inverse square fall off from the values at the reference distance, under the LED colours
+ * that are on: each colour channel sees 1 - 2 x crosstalk of the reflected light of its own LED colour and 
+ * crosstalk of each of the other two, so all three on give the colour table above
+************************************/
+static void sample(unsigned int rgbc[4])
+{
+    int c = 0, i, k;
+    double d = raycast(x + P.sensor * cos(th), y + P.sensor * sin(th), th, &c);
+    double f = 0, ch, lit;
+    const unsigned char led[3] = {hal_regs.led_red, hal_regs.led_green, hal_regs.led_blue};
+    
+    if(d < 2000){f = pow((P.dref + P.d0) / (d + P.d0), 2);}
+    for(i = 0; i < 3; i++)
+    {
+        double cal = (i == 0) ? colours[c].r : (i == 1) ? colours[c].g : colours[c].b;
+        double raw = B_RAW[i] + cal * (W_RAW[i] - B_RAW[i]) / 255;
+        for(lit = 0, k = 0; k < 3; k++){lit += led[k] ? ((k == i) ? 1 - 2 * P.crosstalk : P.crosstalk) : 0;}
+        ch = (P.ambient + raw * f * lit) * (1 + P.noise * noise());
+        rgbc[i + 1] = ch > 0 ? (unsigned int)ch : 0;
+    }
+    ch = (3 * P.ambient + colours[c].clear * f * (led[0] + led[1] + led[2]) / 3) * (1 + P.noise * noise());
+    rgbc[0] = ch > 0 ? (unsigned int)ch : 0;
+}
+
+/************************************
+ * Function to convert a motor's duty and direction registers to wheel speed
+ * The duty encoding follows setMotorPWM(): with the direction pin low the high time is the 
+ * power, with it high the low time is the power and the wheel turns backwards.
+************************************/
+static double wheel(unsigned char duty, unsigned char lat, int pin)
+{
+    double power, v;
+    if(hal_regs.pwm_period <= 0){return 0;}
+    power = 100.0 * duty / hal_regs.pwm_period;
+    if(lat & (1 << pin)){power = -(100.0 - power);}
+    v = (fabs(power) - P.deadband) / (100 - P.deadband);
+    if(v <= 0){return 0;}
+    return (power > 0 ? v : -v) * P.vmax;
+}
+
+/************************************
+ * Function returning the distance of a point to the nearest wall
+************************************/
+static double clearance(double px, double py)
+{
+    double best = HUGE_VAL;
+    int i;
+    for(i = 0; i < n_walls; i++)
+    {
+        double ex = walls[i].x2 - walls[i].x1, ey = walls[i].y2 - walls[i].y1;
+        double l2 = ex * ex + ey * ey, t = 0, dx, dy;
+        if(l2 > 0){t = ((px - walls[i].x1) * ex + (py - walls[i].y1) * ey) / l2;}
+        if(t < 0){t = 0;}
+        if(t > 1){t = 1;}
+        dx = walls[i].x1 + t * ex - px;
+        dy = walls[i].y1 + t * ey - py;
+        if(sqrt(dx * dx + dy * dy) < best){best = sqrt(dx * dx + dy * dy);}
+    }
+    return best;
+}
+
+static double wrap_deg(double a)
+{
+    a = fmod(a * 180 / PI, 360);
+    if(a > 180){a -= 360;}
+    if(a < -180){a += 360;}
+    return a;
+}
+
+/************************************
+ * Function to append a recorded colour read to the dataset, in the dump format of record_dump() plus the label
+ * Inputs: Age of the read in the recorder ring, 1 for the last one, nothing is written with the recorder compiled out
+************************************/
+static void dataset_write(unsigned char age)
+{
+#if RECORD_ENABLED
+    struct Record_sample *s = &record_buf[(unsigned char)(record_head - age) & (RECORD_SIZE - 1)];
+    if(!dataset || !dataset_label){return;}
+    fprintf(dataset, "R%c %c %u %u %u %u %c\n", s->source, s->decision, s->c, s->r, s->g, s->b, dataset_label);
+#else
+    (void)age;
+#endif
+}
+
+/************************************
+ * Function printing the result line, registered with atexit() so timeouts are reported too
+************************************/
+static void report(void)
+{
+    double pos = sqrt((x - sx) * (x - sx) + (y - sy) * (y - sy));
+    double head = wrap_deg(th - sth - PI); // The buggy comes home facing back the way it left
+    const char *result = retrace_done ? (aborted ? "aborted" : "home") : "timeout";
+    
+    dataset_write(1); // The last read has its decision by now
+    
+    printf("maze=%s result=%s time_ms=%lu pos_err_mm=%.0f heading_err_deg=%.1f reads=%d misclass=%d collisions=%d\n",
+        maze_name, result, retrace_done ? end_ms : hal_posix_ms(), pos, fabs(head), reads, misclass, collisions);
+    fflush(stdout);
+}
+
+/************************************
+ * Host tick, integrates the kinematics and advances the sensor model every 1ms
+************************************/
+static void tick(unsigned long now_ms)
+{
+    double vl = P.gain_l * wheel(hal_regs.pwm6dch, hal_regs.late, HAL_MOTOR_L_DIR_PIN);
+    double vr = P.gain_r * wheel(hal_regs.pwm7dch, hal_regs.latg, HAL_MOTOR_R_DIR_PIN);
+    double v = (vl + vr) / 2, w = (vr - vl) / P.wheelbase, dt = 0.001;
+    double nx = x + v * cos(th) * dt, ny = y + v * sin(th) * dt;
+    double front = clearance(nx + P.sensor * cos(th), ny + P.sensor * sin(th));
+    
+    if(front < 3 && front < clearance(x + P.sensor * cos(th), y + P.sensor * sin(th)))
+    {
+        if(!in_contact) // Bumped into a card or wall, stop translating
+        {
+            collisions++;
+            if(verbose){fprintf(stderr, "%8lu collision at %.0f %.0f\n", now_ms, x, y);}
+        }
+        in_contact = 1;
+    }
+    else
+    {
+        x = nx;
+        y = ny;
+        if(front >= 3){in_contact = 0;}
+    }
+    th += w * dt;
+    if(P.gyro){mpu6050_sample(w * 180 / PI + P.gyro_bias + P.gyro_noise * noise_from(&gyro_rng));}
+    tcs3471_tick();
+    if(P.i2c_hang > 0 && now_ms >= P.i2c_hang){hal_posix_i2c_hang(1);}
+    
+    if(retrace_done && vl == 0 && vr == 0 && !end_ms){end_ms = now_ms;} // Home once the final ramp down has finished
+    if(end_ms && (record_sent || now_ms - end_ms >= 1000)){exit(0);} // The firmware reports the run standing still
+}
+
+/************************************
+ * Probe hook, scores classifications against the card actually in front of the sensor
+************************************/
+static void probe(int event, int value)
+{
+    int c = 0;
+    double d;
+    if(event == PROBE_CLASSIFY)
+    {
+        d = raycast(x + P.sensor * cos(th), y + P.sensor * sin(th), th, &c);
+        reads++;
+        if(colours[c].code != value){misclass++;}
+        if(value == 'W' || value == 'K'){aborted = (colours[c].code != 'W');}
+        if(verbose){fprintf(stderr, "%8lu classify %c (card %s at %.0fmm)\n", hal_posix_ms(), value, colours[c].name, d);}
+    }
+    else if(event == PROBE_RECORD) // A new read, the one before it is complete
+    {
+        dataset_write(2);
+        d = raycast(x + P.sensor * cos(th), y + P.sensor * sin(th), th, &c);
+        dataset_label = (d < 2000) ? colours[c].code : '-';
+    }
+    else if(event == PROBE_RETRACE && value == 0)
+    {
+        retrace_done = 1;
+    }
+}
+
+static void uart_tx(char c)
+{
+    static char line[4]; // Start of the current line
+    static int n = 0;
+    if(verbose){fputc(c, stderr);}
+    if(c == '\n')
+    {
+        if(n >= 3 && end_ms && memcmp(line, "RS ", 3) == 0){record_sent = 1;}
+        n = 0;
+    }
+    else if(n < (int)sizeof(line)){line[n++] = c;}
+}
+
+/************************************
+ * Function to load a maze description
+ * Lines: "start x y heading_deg", "wall x1 y1 x2 y2 [colour]", "param name value", '#' comments
+************************************/
+static void load_maze(const char *path)
+{
+    char line[256], word[32], colour[32];
+    double a, b, c, d;
+    FILE *f = fopen(path, "r");
+    if(!f){perror(path); exit(2);}
+    while(fgets(line, sizeof(line), f))
+    {
+        if(sscanf(line, "%31s", word) != 1 || word[0] == '#'){continue;}
+        if(strcmp(word, "start") == 0 && sscanf(line, "%*s %lf %lf %lf", &a, &b, &c) == 3)
+        {
+            sx = x = a; sy = y = b; sth = th = c * PI / 180;
+        }
+        else if(strcmp(word, "wall") == 0 && sscanf(line, "%*s %lf %lf %lf %lf", &a, &b, &c, &d) == 4)
+        {
+            unsigned int i;
+            if(n_walls == MAX_WALLS){fprintf(stderr, "%s: too many walls\n", path); exit(2);}
+            walls[n_walls] = (struct Wall){a, b, c, d, 0};
+            if(sscanf(line, "%*s %*f %*f %*f %*f %31s", colour) == 1)
+            {
+                for(i = 0; i < N_COLOURS && strcmp(colours[i].name, colour) != 0; i++);
+                if(i == N_COLOURS){fprintf(stderr, "%s: unknown colour %s\n", path, colour); exit(2);}
+                walls[n_walls].colour = i;
+            }
+            n_walls++;
+        }
+        else if(strcmp(word, "param") == 0 && sscanf(line, "%*s %31s %lf", colour, &a) == 2)
+        {
+            if(strcmp(colour, "vmax") == 0){P.vmax = a;}
+            else if(strcmp(colour, "deadband") == 0){P.deadband = a;}
+            else if(strcmp(colour, "wheelbase") == 0){P.wheelbase = a;}
+            else if(strcmp(colour, "sensor") == 0){P.sensor = a;}
+            else if(strcmp(colour, "dref") == 0){P.dref = a;}
+            else if(strcmp(colour, "d0") == 0){P.d0 = a;}
+            else if(strcmp(colour, "ambient") == 0){P.ambient = a;}
+            else if(strcmp(colour, "noise") == 0){P.noise = a;}
+            else if(strcmp(colour, "gain_l") == 0){P.gain_l = a;}
+            else if(strcmp(colour, "gain_r") == 0){P.gain_r = a;}
+            else if(strcmp(colour, "i2c_hang") == 0){P.i2c_hang = a;}
+            else if(strcmp(colour, "crosstalk") == 0){P.crosstalk = a;}
+            else if(strcmp(colour, "gyro") == 0){P.gyro = a;}
+            else if(strcmp(colour, "gyro_bias") == 0){P.gyro_bias = a;}
+            else if(strcmp(colour, "gyro_noise") == 0){P.gyro_noise = a;}
+            else{fprintf(stderr, "%s: unknown param %s\n", path, colour); exit(2);}
+        }
+        else
+        {
+            fprintf(stderr, "%s: cannot parse: %s", path, line);
+            exit(2);
+        }
+    }
+    fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+    unsigned long limit = 120000; // Two minutes of virtual time
+    
+    for(i = 1; i < argc - 1; i++)
+    {
+        if(strcmp(argv[i], "-v") == 0){verbose = 1;}
+        else if(strcmp(argv[i], "-t") == 0 && i + 2 < argc){limit = strtoul(argv[++i], 0, 10);}
+        else if(strcmp(argv[i], "-s") == 0 && i + 2 < argc){rng = strtoul(argv[++i], 0, 10);}
+        else if(strcmp(argv[i], "-e") == 0 && i + 2 < argc){hal_posix_eeprom_file(argv[++i]);}
+        else if(strcmp(argv[i], "-d") == 0 && i + 2 < argc)
+        {
+            dataset = fopen(argv[++i], "a");
+            if(!dataset){perror(argv[i]); return 2;}
+        }
+        else if(strcmp(argv[i], "-r") == 0 && i + 2 < argc && hal_posix_schedule_rx(argv[i + 1]) == 0){i++;}
+        else{break;}
+    }
+    if(i != argc - 1)
+    {
+        fprintf(stderr, "usage: %s [-v] [-t limit_ms] [-s seed] [-e eeprom_file] [-d dataset_file] [-r ms:text]... maze_file\n", argv[0]);
+        return 2;
+    }
+    maze_name = argv[i];
+    load_maze(maze_name);
+    
+    tcs3471_attach(sample);
+    if(P.gyro){mpu6050_attach();}
+    hal_host.tick = tick;
+    hal_host.probe = probe;
+    hal_host.uart_tx = uart_tx;
+    hal_posix_run(limit);
+    atexit(report);
+    hal_posix_boot(firmware_main); // Never returns, the run ends in tick() or at the time limit
+    return 0;
+}
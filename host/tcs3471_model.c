@@ -0,0 +1,163 @@
+#include "hal.h"
+#include "tcs3471_model.h"
+
+#define REG_ENABLE  0x00    // PON bit 0, AEN bit 1, AIEN bit 4
+#define REG_ATIME   0x01
+#define REG_AILTL   0x04    // Clear low threshold, AILTH at 0x05
+#define REG_AIHTL   0x06    // Clear high threshold, AIHTH at 0x07
+#define REG_PERS    0x0C
+#define REG_ID      0x12
+#define REG_STATUS  0x13    // AVALID bit 0, AINT bit 4
+#define REG_CDATAL  0x14    // Clear, red, green, blue, low byte first
+
+#define REF_ATIME_CYCLES 43 // (256 - 0xD5), integration the sample function is scaled for
+
+static unsigned char regs[0x20];        // Register file
+static unsigned char pointer;           // Register addressed by the last command
+static unsigned char auto_inc;          // Command was an auto increment transaction
+static unsigned char state;             // 0 expecting address, 1 expecting command, 2 data
+static unsigned char reading;           // Read transaction in progress
+static unsigned long cycle_us;          // Time into the current integration cycle
+static unsigned char persist_count;     // Consecutive cycles outside the thresholds
+static unsigned char pin_low;           // INT pin asserted
+static tcs3471_sample_fn sample_fn;
+
+static void bus_start(void) {state = 0;}
+static void bus_stop(void) {state = 0;}
+
+/************************************
+ * I2C write callback, address byte, then command byte, then register data
+************************************/
+static void bus_write(unsigned char b)
+{
+    if(state == 0) // Address byte
+    {
+        reading = (b & 0x01);
+        state = ((b & 0xFE) == TCS3471_ADDR) ? (reading ? 2 : 1) : 3; // 3: other device, ignored
+        return;
+    }
+    if(state == 1) // Command byte
+    {
+        if((b & 0x60) == 0x60) // Special function
+        {
+            if((b & 0x1F) == 0x06) // RGBC interrupt clear
+            {
+                regs[REG_STATUS] &= ~0x10;
+                pin_low = 0;
+            }
+        }
+        else
+        {
+            pointer = b & 0x1F;
+            auto_inc = ((b & 0x60) == 0x20);
+        }
+        state = 2;
+        return;
+    }
+    if(state == 2 && !reading) // Register data
+    {
+        if((pointer & 0x1F) == REG_ENABLE && !(b & 0x02)) // ADC off, the next integration starts from the beginning
+        {
+            cycle_us = 0;
+            regs[REG_STATUS] &= ~0x01;
+        }
+        regs[pointer & 0x1F] = b;
+        if(auto_inc){pointer++;}
+    }
+}
+
+/************************************
+ * I2C read callback, returns the addressed register
+************************************/
+static unsigned char bus_read(void)
+{
+    unsigned char b;
+    if(state != 2 || !reading){return 0xFF;}
+    b = regs[pointer & 0x1F];
+    if(auto_inc){pointer++;}
+    return b;
+}
+
+static struct HAL_i2c_device tcs3471_device = {bus_start, bus_write, bus_read, bus_stop};
+
+/************************************
+ * Function to attach the model to the POSIX I2C bus
+ * Inputs: Function sampling the RGBC counts of the scene
+ * Outputs: None
+************************************/
+void tcs3471_attach(tcs3471_sample_fn sample)
+{
+    sample_fn = sample;
+    regs[REG_ID] = 0x14;
+    regs[REG_ATIME] = 0xFF;
+    hal_posix_i2c_attach(&tcs3471_device);
+}
+
+/************************************
+ * Function returning the number of consecutive out of range cycles needed for an interrupt
+************************************/
+static unsigned char persistence(void)
+{
+    unsigned char p = regs[REG_PERS] & 0x0F;
+    if(p <= 3){return p ? p : 1;}
+    return 5 * (p - 3);
+}
+
+/************************************
+ * Function to advance the model by 1ms, called from the host tick
+ * Inputs: None
+ * Outputs: None
+ * At the end of every integration cycle the data registers are updated and the clear channel 
+ * is compared with the thresholds. INT1 is raised on the falling edge of the INT pin.
+************************************/
+void tcs3471_tick(void)
+{
+    unsigned int rgbc[4];
+    unsigned long cycles, period_us, v, low, high;
+    int i;
+    
+    if((regs[REG_ENABLE] & 0x03) != 0x03){cycle_us = 0; return;} // PON and AEN needed
+    cycles = 256 - regs[REG_ATIME];
+    period_us = cycles * 2400;
+    cycle_us += 1000;
+    if(cycle_us < period_us){return;}
+    cycle_us -= period_us;
+    
+    sample_fn(rgbc);
+    for(i = 0; i < 4; i++)
+    {
+        v = (unsigned long)rgbc[i] * cycles / REF_ATIME_CYCLES;
+        if(v > cycles * 1024){v = cycles * 1024;} // ADC full scale
+        if(v > 0xFFFF){v = 0xFFFF;}
+        regs[REG_CDATAL + 2*i] = v & 0xFF;
+        regs[REG_CDATAL + 2*i + 1] = v >> 8;
+    }
+    regs[REG_STATUS] |= 0x01; // AVALID
+    
+    v = regs[REG_CDATAL] | (regs[REG_CDATAL + 1] << 8);
+    low = regs[REG_AILTL] | (regs[REG_AILTL + 1] << 8);
+    high = regs[REG_AIHTL] | (regs[REG_AIHTL + 1] << 8);
+    if(v < low || v > high || (regs[REG_PERS] & 0x0F) == 0){persist_count++;} // APERS 0 interrupts every cycle
+    else{persist_count = 0;}
+    
+    if((regs[REG_ENABLE] & 0x10) && persist_count >= persistence())
+    {
+        persist_count = 0;
+        regs[REG_STATUS] |= 0x10; // AINT
+        if(!pin_low)
+        {
+            pin_low = 1;
+            hal_posix_int1(); // Falling edge on RB1
+        }
+    }
+}
+
+/************************************
+ * Function to read a register of the model, for the simulator report
+ * Inputs: Register address
+ * Outputs: Register value
+************************************/
+unsigned char tcs3471_reg(unsigned char address)
+{
+    return regs[address & 0x1F];
+}
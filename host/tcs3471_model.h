@@ -0,0 +1,21 @@
+#ifndef _tcs3471_model_H
+#define _tcs3471_model_H
+
+/************************************
+ * Register level model of the TCS3471 colour sensor on the colour click, attached to the 
+ * POSIX I2C bus. RGBC counts are latched at the end of every integration cycle from a 
+ * host supplied sampling function, and the clear channel interrupt (thresholds, persistence,
+ * clear special function) drives INT1 like the real INT pin.
+************************************/
+
+#define TCS3471_ADDR 0x52   // 7 bit address 0x29 shifted left, as used by the firmware
+
+// Samples the scene for one integration cycle, counts are for the firmware ATIME of 0xD5
+typedef void (*tcs3471_sample_fn)(unsigned int rgbc[4]);
+
+//function prototypes (Function descriptions are to be found in the .c file)
+void tcs3471_attach(tcs3471_sample_fn sample);
+void tcs3471_tick(void);
+unsigned char tcs3471_reg(unsigned char address);
+
+#endif
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Turn a trace dump from the buggy into a timeline and per-event latency histograms.
+
+The dump is the serial output of trace_dump() (lines "T<ring> <id> <ms> <timer1>" and the Idle time
+"TI <idle_ms> <run_ms>", ended by "TE"), captured from Realterm or from build/host/<profile>/sim -v.
+Event names are read from trace.h.
+
+usage: trace_report.py [--timeline] [capture_file]    (reads stdin without a file)
+"""
+import os
+import re
+import sys
+
+RINGS = ("loop", "low", "high")
+END_FLAG = 0x80
+TMR1_US = 32768         # Timer1 wraps every 32.768ms at 0.5us per count
+PERIOD_US = 4096000     # Timer1 and the 8 bit ms tick only repeat together every 4.096s
+
+
+def event_names():
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "trace.h")
+    names = {}
+    with open(path) as f:
+        for line in f:
+            m = re.match(r"#define\s+TR_(\w+)\s+(\d+)", line)
+            if m:
+                names[int(m.group(2))] = m.group(1).lower()
+    return names
+
+
+def parse(lines):
+    """Returns the events per ring (oldest first) and the (idle_ms, run_ms) of the last complete dump"""
+    rings, dump, idle, dump_idle = [[] for _ in RINGS], None, None, None
+    for line in lines:
+        line = line.strip()
+        if line == "TE":
+            if dump is not None:
+                rings, idle = dump, dump_idle
+            dump, dump_idle = None, None
+            continue
+        m = re.match(r"TI (\d+) (\d+)$", line)
+        if m:
+            dump_idle = (int(m.group(1)), int(m.group(2)))
+            continue
+        m = re.match(r"T([0-2]) ([0-9A-F]{2}) ([0-9A-F]{2}) ([0-9A-F]{4})$", line)
+        if not m:
+            continue
+        if dump is None:
+            dump = [[] for _ in RINGS]
+        dump[int(m.group(1))].append((int(m.group(2), 16), int(m.group(3), 16), int(m.group(4), 16)))
+    return rings, idle
+
+
+def modulo_time(ms, t):
+    """Time in us modulo PERIOD_US matching both the Timer1 count and the low byte of the ms tick"""
+    fine = t // 2
+    best = None
+    for k in range(PERIOD_US // TMR1_US + 1):
+        us = (fine + k * TMR1_US) % PERIOD_US
+        err = abs(((us // 1000) - ms + 128) % 256 - 128)  # The two timers are not phase locked, allow 1ms
+        if best is None or err < best[0]:
+            best = (err, us)
+    return best[1]
+
+
+def unwrap(events):
+    """Absolute times in us, assuming consecutive events of a ring are less than 4.096s apart"""
+    out, prev = [], None
+    for eid, ms, t in events:
+        us = modulo_time(ms, t)
+        if prev is not None:
+            us += (prev - us + PERIOD_US - 1) // PERIOD_US * PERIOD_US if us < prev else 0
+        out.append((us, eid))
+        prev = us
+    return out
+
+
+def main(argv):
+    timeline = "--timeline" in argv
+    files = [a for a in argv[1:] if not a.startswith("--")]
+    lines = open(files[0]).readlines() if files else sys.stdin.readlines()
+    names = event_names()
+    rings, idle = parse(lines)
+    rings = [unwrap(r) for r in rings]
+    if not any(rings):
+        sys.exit("no complete trace dump found")
+    if idle and idle[1]:
+        print("idle %d of %d ms (%.1f%%), the core is stopped for that share of the run\n"
+              % (idle[0], idle[1], 100.0 * idle[0] / idle[1]))
+
+    # The newest event of every ring is just before the dump, align the ISR rings to the loop ring
+    ref = max(r[-1][0] for r in rings if r)
+    for i, r in enumerate(rings):
+        if r:
+            shift = round((ref - r[-1][0]) / PERIOD_US) * PERIOD_US
+            rings[i] = [(us + shift, eid) for us, eid in r]
+
+    merged = sorted((us, ring, eid) for ring, r in enumerate(rings) for us, eid in r)
+    start = merged[0][0]
+    durations, open_events = {}, {}
+    for us, ring, eid in merged:
+        name = names.get(eid & ~END_FLAG, "id%d" % (eid & ~END_FLAG))
+        key = (ring, eid & ~END_FLAG)
+        note = ""
+        if eid & END_FLAG:
+            if key in open_events:
+                d = us - open_events.pop(key)
+                durations.setdefault(name, []).append(d)
+                note = "%9.1fus" % d
+        else:
+            open_events[key] = us
+        if timeline:
+            print("%12.3fms %-4s %-12s %-5s %s" % ((us - start) / 1000.0, RINGS[ring], name,
+                                                   "end" if eid & END_FLAG else "begin", note))
+
+    if timeline:
+        print()
+    print("%-12s %6s %10s %10s %10s %10s" % ("event", "count", "min_us", "mean_us", "p90_us", "max_us"))
+    for name in sorted(durations):
+        d = sorted(durations[name])
+        print("%-12s %6d %10.1f %10.1f %10.1f %10.1f" % (name, len(d), d[0], sum(d) / len(d),
+                                                         d[min(len(d) - 1, int(len(d) * 0.9))], d[-1]))
+    for name in sorted(durations):
+        print("\n%s" % name)
+        buckets = {}
+        for v in durations[name]:
+            b = 0
+            while (1 << b) <= v:
+                b += 1
+            buckets[b] = buckets.get(b, 0) + 1
+        top = max(buckets.values())
+        for b in sorted(buckets):
+            lo = 0 if b == 0 else 1 << (b - 1)
+            print("  %7d-%-7dus %5d %s" % (lo, (1 << b) - 1 if b else 0, buckets[b], "#" * max(1, buckets[b] * 40 // top)))
+
+
+if __name__ == "__main__":
+    main(sys.argv)
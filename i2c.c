@@ -1,5 +1,7 @@
-#include <xc.h>
 #include "i2c.h"
+#include "power.h"
+#include "timers.h"
+#include "supervisor.h"
 
 
 /********************************************//**
@@ -7,29 +9,27 @@
  ***********************************************/
 void I2C_2_Master_Init(void)
 {
-  //i2c config  
-  SSP2CON1bits.SSPM= 0b1000;    // i2c master mode
-  SSP2CON1bits.SSPEN = 1;       //enable i2c
-  SSP2ADD = (_XTAL_FREQ/(4*_I2C_CLOCK))-1; //Baud rate divider bits (in master mode)
-  
-  //pin configuration for i2c  
-  TRISDbits.TRISD5 = 1;                   //Disable output driver
-  TRISDbits.TRISD6 = 1;                   //Disable output driver
-  ANSELDbits.ANSELD5=0;
-  ANSELDbits.ANSELD6=0;
-  SSP2DATPPS=0x1D;      //pin RD5
-  SSP2CLKPPS=0x1E;      //pin RD6
-  RD5PPS=0x1C;      // data output
-  RD6PPS=0x1B;      //clock output
+  hal_i2c_init();   //i2c master mode, baud rate and pin configuration
 }
 
 
 /********************************************//**
- *  Function to wait until I2C is idle
+ *  Function to wait until I2C is idle, in Idle mode until the MSSP2 interrupt at the end of the transfer
+ *  A bus still busy after I2C_TIMEOUT_MS (e.g. a glitch holding SDA low) restarts the PIC into safe mode
  ***********************************************/
 void I2C_2_Master_Idle(void)
 {
-  while ((SSP2STAT & 0x04) || (SSP2CON2 & 0x1F)); // wait until bus is idle
+  unsigned long start;
+  HAL_INTERRUPTS(0);
+  start = ms_ticks;
+  while (HAL_I2C_BUSY()) // wait until bus is idle
+  {
+    if(ms_ticks - start > I2C_TIMEOUT_MS){supervisor_fault(SUP_FAULT_I2C);}
+    power_idle();
+    HAL_INTERRUPTS(1);    // Service the interrupt that woke the core
+    HAL_INTERRUPTS(0);
+  }
+  HAL_INTERRUPTS(1);
 }
 
 /********************************************//**
@@ -38,7 +38,7 @@ void I2C_2_Master_Idle(void)
 void I2C_2_Master_Start(void)
 {
   I2C_2_Master_Idle();    
-  SSP2CON2bits.SEN = 1;             //Initiate start condition
+  HAL_I2C_START();                  //Initiate start condition
 }
 
 /********************************************//**
@@ -47,7 +47,7 @@ void I2C_2_Master_Start(void)
 void I2C_2_Master_RepStart(void)
 {
   I2C_2_Master_Idle();
-  SSP2CON2bits.RSEN = 1;           //Initiate repeated start condition
+  HAL_I2C_RESTART();               //Initiate repeated start condition
 }
 
 /********************************************//**
@@ -56,7 +56,7 @@ void I2C_2_Master_RepStart(void)
 void I2C_2_Master_Stop()
 {
   I2C_2_Master_Idle();
-  SSP2CON2bits.PEN = 1;           //Initiate stop condition
+  HAL_I2C_STOP();                 //Initiate stop condition
 }
 
 /********************************************//**
@@ -65,7 +65,7 @@ void I2C_2_Master_Stop()
 void I2C_2_Master_Write(unsigned char data_byte)
 {
   I2C_2_Master_Idle();
-  SSP2BUF = data_byte;         //Write data to SSPBUF
+  HAL_I2C_WRITE(data_byte);    //Write data to SSPBUF
 }
 
 /********************************************//**
@@ -75,11 +75,10 @@ unsigned char I2C_2_Master_Read(unsigned char ack)
 {
   unsigned char tmp;
   I2C_2_Master_Idle();
-  SSP2CON2bits.RCEN = 1;        // put the module into receive mode
+  HAL_I2C_RECEIVE();            // put the module into receive mode
   I2C_2_Master_Idle();
-  tmp = SSP2BUF;                //Read data from SS2PBUF
+  tmp = HAL_I2C_READ();         //Read data from SS2PBUF
   I2C_2_Master_Idle();
-  SSP2CON2bits.ACKDT = !ack;     // 0 turns on acknowledge data bit
-  SSP2CON2bits.ACKEN = 1;        //start acknowledge sequence
+  HAL_I2C_ACK(ack);              //set the acknowledge data bit and start acknowledge sequence
   return tmp;
 }
@@ -1,10 +1,10 @@
 #ifndef _i2c_H
 #define _i2c_H
 
-#include <xc.h>
+#include "hal.h"
 
-#define _XTAL_FREQ 64000000 //note intrinsic _delay function is 62.5ns at 64,000,000Hz  
 #define _I2C_CLOCK 100000 //100kHz for I2C
+#define I2C_TIMEOUT_MS 5 //Longest wait for MSSP2, a byte takes 90us, then the bus is taken as hung
 
 //function prototypes (Function descriptions are to be found in the .c file)
 void I2C_2_Master_Init(void);
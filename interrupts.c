@@ -1,12 +1,23 @@
-#include <xc.h>
 #include "interrupts.h"
 #include "serial.h"
 #include "color.h"
 #include "i2c.h"
+#include "timers.h"
+#include "trace.h"
+#include "lights.h"
+#include "supervisor.h"
+#include "motion.h"
+#include "perf.h"
+#include <stdio.h>
 
 // Declare external variable for use in the ISR
 extern unsigned int check;
 
+static volatile unsigned char int1_pending = 0; // Set by LowISR, cleared once the deferred handler has acknowledged the color click
+static volatile unsigned long int1_stamp = 0;   // ms tick at which INT1 was captured
+static unsigned char int1_check = 0;            // check was set from INT1, not by the colour stream, so int1_stamp is its start
+struct ISR_stats isr_stats;                     // Worst case latencies, reported over serial
+
 /************************************
  * High priority interrupt service routine to handle the receiving and transmitting data
  * Input: none
@@ -16,17 +27,19 @@ extern unsigned int check;
 ************************************/
 void __interrupt(high_priority) HighISR()
 {
-	if(PIR4bits.RC4IF) // If recieve register is flagged
+    TRACE_BEGIN(high, TR_HIGHISR);
+	if(HAL_UART_RX_READY()) // If recieve register is flagged
     {
-        putCharToRxBuf(RC4REG);  //Put byte in register to recieve buffer. return byte in RCREG. clear RC4IF by reading the data in RC4REG.
+        putCharToRxBuf(HAL_UART_READ());  //Put byte in register to recieve buffer. return byte in RCREG. clear RC4IF by reading the data in RC4REG.
     }
-    if(PIR4bits.TX4IF){ // If something transmitted
+    if(HAL_UART_TX_READY()){ // If something transmitted
         if(isDataInTxBuf()){ // If data in transmit buffer
-            TX4REG = getCharFromTxBuf(); // Set register to transmitted characters in transmit buffer
+            HAL_UART_WRITE(getCharFromTxBuf()); // Set register to transmitted characters in transmit buffer
         }else{
-            PIE4bits.TX4IE = 0; // Reset Flag, the TX4IF for the transmit register is set whenever the TX4REG is empty
+            HAL_UART_TX_INT(0); // Reset Flag, the TX4IF for the transmit register is set whenever the TX4REG is empty
         }
     }
+    TRACE_END(high, TR_HIGHISR);
 }
 
 /************************************
@@ -49,9 +62,9 @@ void interrupts_slave_init()
     //Setting clear light low threshold higher byte 
     color_writetoaddr(0x05,0b00000000);
     //Setting clear light high threshold lower byte 
-    color_writetoaddr(0x06,0b11011100);
+    color_writetoaddr(0x06,CLEAR_THRESHOLD & 0xFF);
     //Setting clear light high threshold higher byte
-    color_writetoaddr(0x07,0b00000101);     	//1500 
+    color_writetoaddr(0x07,CLEAR_THRESHOLD >> 8);
     //Also add you battery monitoring so that the car turns around when its at 50% of it's starting value 
 }
 
@@ -63,42 +76,108 @@ void interrupts_slave_init()
 ************************************/
 void interrupts_master_init()
 {
-    // Turn on Global Interrupts, Peripheral Interrupts, and Interrupt Source (Turn on Global last)
-    PIE4bits.RC4IE=1;	//receive interrupt
-    //transmit interrupt (only turn on when you have more than one byte to send)
-    INTCONbits.IPEN = 1; // Enaable priority levels on interrupt
-    INTCONbits.GIEL = 1; //Enable peripheral interrupt
-    INTCONbits.GIEH = 1; // Enable global interrupt
-    
-    //Enabling external interrupts on the clicker board
-    PIE0bits.INT1IE = 1; //Enabling interrupt INT0
-    IPR0bits.INT1IP = 0; //Setting interrupt priority high (1) or low (0)
-    INTCONbits.GIE = 1; //Enabling global interrupts to have the processor branch to the interrupt vector following wakeup
-    INTCONbits.INT1EDG = 0; //Interrupt set to occur on a falling edge because the the interrupt on the TCS causes the pin to go low
-    INT1PPS = 0b001001; //Setting RB1 as the interrupt pin (it is by default, just to be sure)
-    
-    //Initializing the external interrupt pin on the board
-    TRISBbits.TRISB1 = 1;
-    ANSELBbits.ANSELB1=0;
+    hal_interrupts_init(); // Priority levels, EUSART4 receive and falling edge INT1 on RB1
 }
 
 /************************************
- * Low priority interrupt service routine to handle setting the check value high if the clear light value 
- * falls outside of the set threshold 
+ * Low priority interrupt service routine to count the 1ms system tick, play the light patterns and to capture
+ * the colour click interrupt. The I2C acknowledge and debounce are deferred to interrupts_service()
+ * so that the ISR never blocks.
  * Inputs: None
  * Outputs: None
- * Functions called within: The function to clear the interrupt flag in the color click is called
+ * Functions called within: None
 ************************************/
 void __interrupt(low_priority) LowISR()
 {
-    if(PIR0bits.INT1IF)                     //check the interrupt source
+    unsigned int entry, duration;
+    entry = HAL_TMR1_READ();                // Entry timestamp for the ISR duration
+    TRACE_BEGIN(low, TR_LOWISR);
+    
+    if(HAL_TMR0_FLAG)                       // 1ms system tick
+    {
+        ms_ticks++;
+        motion_tick();                      // End the motion primitive on its tick
+        perf_tick();                        // Count the run time of the current phase
+        lights_tick();                      // Advance the light patterns
+        supervisor_tick();                  // Clear the watchdog while the main code checks in
+        HAL_TMR0_FLAG = 0;
+    }
+    if(HAL_INT1_FLAG)                       //check the interrupt source
     {                                       
-        check = 1; // Trigger colour detection routine in main.c
-        LATHbits.LATH3 = !LATHbits.LATH3;
-        __delay_ms(10);
-        interrupt_clear();//clear the interrupt flag in the slave
-        PIR0bits.INT1IF = 0;               //clear the interrupt flag in the master                     
+        int1_stamp = ms_ticks;              // Timestamp the event for debounce and latency measurement
+        int1_pending = 1;                   // Hand over to the deferred handler in main
+        isr_stats.events++;
+        HAL_GPIO_TOGGLE(PIN_DEBUG);
+        HAL_INT1_FLAG = 0;                 //clear the interrupt flag in the master                     
 	}
+    if(HAL_I2C_FLAG){HAL_I2C_FLAG = 0;}     // End of an I2C transfer, only used to wake the core from Idle
+    
+    duration = HAL_TMR1_READ() - entry;     // Time spent in this ISR
+    if(duration > isr_stats.isr_max){isr_stats.isr_max = duration;}
+    TRACE_END(low, TR_LOWISR);
+}
+
+/************************************
+ * Deferred handler for the colour click interrupt, called from the main loop
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: The function to clear the interrupt flag in the color click is called
+ * once the line has had INT1_DEBOUNCE_MS to settle, and the check flag is then set for main.c.
+ * The colour click holds its interrupt line low until it is cleared, so no further INT1 edge
+ * (and no write to int1_stamp) can occur while an event is pending.
+************************************/
+void interrupts_service(void)
+{
+    if(int1_pending && (get_ms() - int1_stamp) >= INT1_DEBOUNCE_MS)
+    {
+        interrupt_clear();  //clear the interrupt flag in the slave
+        int1_pending = 0;
+        int1_check = 1;
+        check = 1;          // Trigger colour detection routine in main.c
+    }
+}
+
+/************************************
+ * Function to record the delay between the colour click interrupt and main.c servicing check
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: None, a check set by the colour stream has no interrupt to measure from and is skipped
+************************************/
+void interrupts_check_serviced(void)
+{
+    unsigned long latency = get_ms() - int1_stamp;
+    if(int1_check && latency > isr_stats.service_max){isr_stats.service_max = latency;}
+    int1_check = 0;
+}
+
+/************************************
+ * Function to drop colour click interrupts raised while check was being serviced 
+ * (e.g. while still in front of the card), matching the old behaviour of clearing check afterwards
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: The function to clear the interrupt flag in the color click is called
+************************************/
+void interrupts_flush(void)
+{
+    int1_check = 0;
+    if(int1_pending)
+    {
+        interrupt_clear();
+        int1_pending = 0;
+    }
+}
+
+/************************************
+ * Function to send the interrupt latency statistics to the serial terminal
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: The serial function to send a string is called
+************************************/
+void interrupts_report(void)
+{
+    char msg[40];
+    sprintf(msg,"ISR %uus CHK %lums N %u\n",isr_stats.isr_max/2,isr_stats.service_max,isr_stats.events);
+    sendStringSerial4(msg);
 }
 
 /************************************
@@ -1,9 +1,15 @@
 #ifndef _interrupts_H
 #define _interrupts_H
 
-#include <xc.h>
+#include "hal.h"
 
-#define _XTAL_FREQ 64000000
+struct ISR_stats { //Latency instrumentation for the colour click interrupt
+    unsigned int isr_max;       //worst case LowISR duration in Timer1 counts (0.5us)
+    unsigned long service_max;  //worst case delay from INT1 to check being serviced in main, in ms
+    unsigned int events;        //number of colour click interrupts captured
+};
+
+extern struct ISR_stats isr_stats;
 
 //function prototypes (Function descriptions are to be found in the .c file)
 void Interrupts_init(void);
@@ -12,5 +18,9 @@ void interrupts_slave_init(void);
 void interrupts_master_init(void);
 void interrupt_clear(void);
 void __interrupt(low_priority) LowISR();
+void interrupts_service(void);
+void interrupts_check_serviced(void);
+void interrupts_flush(void);
+void interrupts_report(void);
 
 #endif
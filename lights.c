@@ -1,6 +1,7 @@
-#include <xc.h>
 #include "lights.h"
 
+static struct Light_anim anims[LIGHTS_N]; // Animation of each light, written by main and played by the LowISR tick
+
 /************************************************
 Function to initialise buggy LED's
  * Inpute: None
@@ -9,27 +10,95 @@ Function to initialise buggy LED's
  ***********************************************/
 void lights_init(void)
 {   
-    //Initialize pins for car LEDs as outputs
-    TRISDbits.TRISD3 = 0; // Main Beam (Full brightness)
-    TRISDbits.TRISD4 = 0; // Brake (Full brightness)
-    TRISFbits.TRISF0 = 0; // Turn Left
-    TRISHbits.TRISH0 = 0; // Turn Right
-    TRISHbits.TRISH1 = 0; // Headlamps (Front + Rear at reduced brightness)
+    hal_gpio_init(); //Initialize pins for car LEDs, RGB LED and debugging LED as outputs
     
     // Set initial pin states for car LEDs
-    LATDbits.LATD3 = 0; // Main Beam (Full brightness)
-    LATDbits.LATD4 = 0; // Brake (Full brightness)
-    LATFbits.LATF0 = 0; // Turn Left
-    LATHbits.LATH0 = 0; // Turn Right
-    LATHbits.LATH1 = 0; // Headlamps (Front + Rear at reduced brightness)
-    
-    // Initialize pins for RGB
-    TRISGbits.TRISG1 = 0; // Red LED
-    TRISAbits.TRISA4 = 0; // Green LED
-    TRISFbits.TRISF7 = 0; // Blue LED
+    HAL_GPIO_WRITE(PIN_BEAM, 0);      // Main Beam (Full brightness)
+    HAL_GPIO_WRITE(PIN_BRAKE, 0);     // Brake (Full brightness)
+    HAL_GPIO_WRITE(PIN_TURN_L, 0);    // Turn Left
+    HAL_GPIO_WRITE(PIN_TURN_R, 0);    // Turn Right
+    HAL_GPIO_WRITE(PIN_HEADLAMPS, 0); // Headlamps (Front + Rear at reduced brightness)
     
     // Set initial pin states for RGB
-    LATGbits.LATG1 = 1; // Red LED
-    LATAbits.LATA4 = 1; // Green LED
-    LATFbits.LATF7 = 1; // Blue LED
+    HAL_GPIO_WRITE(PIN_LED_RED, 1);   // Red LED
+    HAL_GPIO_WRITE(PIN_LED_GREEN, 1); // Green LED
+    HAL_GPIO_WRITE(PIN_LED_BLUE, 1);  // Blue LED
+}
+
+/************************************************
+Function to start a pattern on one light, it is played by lights_tick() while the caller carries on
+ * Inpute: Light (LIGHT_...), pattern with the state of each step (bit 0 first), number of steps (up to 8), 
+ * duration of each step in ms and the end of pattern mode (LIGHT_ONCE, LIGHT_REPEAT or LIGHT_HOLD)
+ * Output: None
+ * Functions called: None
+ ***********************************************/
+void lights_play(char light, unsigned char pattern, unsigned char steps, unsigned int step_ms, char mode)
+{
+    struct Light_anim *a = &anims[light];
+    a->active = 0;      // Keep the tick off the light while the pattern is replaced
+    a->pattern = pattern;
+    a->steps = steps;
+    a->step = 0;
+    a->step_ms = step_ms;
+    a->ms = 1;          // First step is shown on the next tick
+    a->mode = mode;
+    a->active = 1;
+}
+
+/************************************************
+Function to switch one light steadily on or off, cancelling its pattern
+ * Inpute: Light (LIGHT_...), 1 for on, 0 for off
+ * Output: None
+ * Functions called: lights_play() with a one step pattern that is held
+ ***********************************************/
+void lights_set(char light, char on)
+{
+    lights_play(light, on ? 1 : 0, 1, 1, LIGHT_HOLD);
+}
+
+/************************************************
+Function to write one light, only called from lights_tick() so that all pin writes happen in the LowISR
+ * Inpute: Light (LIGHT_...), 1 for on, 0 for off
+ * Output: None
+ * Functions called: None
+ ***********************************************/
+static void light_write(char light, char on)
+{
+    switch(light)
+    {
+        case LIGHT_BEAM:      HAL_GPIO_WRITE(PIN_BEAM, on); break;
+        case LIGHT_BRAKE:     HAL_GPIO_WRITE(PIN_BRAKE, on); break;
+        case LIGHT_TURN_L:    HAL_GPIO_WRITE(PIN_TURN_L, on); break;
+        case LIGHT_TURN_R:    HAL_GPIO_WRITE(PIN_TURN_R, on); break;
+        case LIGHT_HEADLAMPS: HAL_GPIO_WRITE(PIN_HEADLAMPS, on); break;
+        case LIGHT_RED:       HAL_GPIO_WRITE(PIN_LED_RED, on); break;
+        case LIGHT_GREEN:     HAL_GPIO_WRITE(PIN_LED_GREEN, on); break;
+        case LIGHT_BLUE:      HAL_GPIO_WRITE(PIN_LED_BLUE, on); break;
+    }
+}
+
+/************************************************
+Function to advance the light patterns, called by the LowISR on every 1ms tick
+ * Inpute: None
+ * Output: None
+ * Functions called: light_write() to show each step
+ ***********************************************/
+void lights_tick(void)
+{
+    char i;
+    struct Light_anim *a;
+    for(i = 0; i < LIGHTS_N; i++)
+    {
+        a = &anims[i];
+        if(!a->active || --a->ms){continue;} // Nothing playing or the step is not over yet
+        if(a->step >= a->steps) // End of the pattern
+        {
+            if(a->mode == LIGHT_HOLD){a->active = 0; continue;}
+            if(a->mode == LIGHT_ONCE){light_write(i, 0); a->active = 0; continue;}
+            a->step = 0;
+        }
+        light_write(i, (a->pattern >> a->step) & 1);
+        a->step++;
+        a->ms = a->step_ms;
+    }
 }
@@ -1,9 +1,40 @@
 #ifndef _lights_H
 #define _lights_H
 
-#include <xc.h>
+#include "hal.h"
+
+// Lights driven by the animation engine
+#define LIGHT_BEAM      0
+#define LIGHT_BRAKE     1
+#define LIGHT_TURN_L    2
+#define LIGHT_TURN_R    3
+#define LIGHT_HEADLAMPS 4
+#define LIGHT_RED       5
+#define LIGHT_GREEN     6
+#define LIGHT_BLUE      7
+#define LIGHTS_N        8
+
+// What a light does at the end of its pattern
+#define LIGHT_ONCE      0   // Turn off
+#define LIGHT_REPEAT    1   // Play the pattern again
+#define LIGHT_HOLD      2   // Keep the state of the last step
+
+#define INDICATOR_MS    150 // On and off time of the turn indicators
+
+struct Light_anim { //Pattern played on one light by lights_tick()
+    unsigned char pattern;  // Light state for each step, bit 0 first
+    unsigned char steps;    // Number of steps in the pattern, up to 8
+    unsigned char step;     // Next step to show
+    unsigned int step_ms;   // Duration of each step in ms
+    unsigned int ms;        // ms left until the next step is shown
+    char mode;              // LIGHT_ONCE, LIGHT_REPEAT or LIGHT_HOLD
+    volatile char active;   // Set while lights_tick() plays the pattern
+};
 
 //function prototype (Function descriptions are to be found in the .c file)
 void lights_init(void);
+void lights_play(char light, unsigned char pattern, unsigned char steps, unsigned int step_ms, char mode);
+void lights_set(char light, char on);
+void lights_tick(void);
 
 #endif
@@ -4,180 +4,356 @@
 
 // CONFIG3L
 #pragma config WDTCPS = WDTCPS_31// WDT Period Select bits (Divider ratio 1:65536; software control of WDTPS)
-#pragma config WDTE = OFF        // WDT operating mode (WDT enabled regardless of sleep)
+#pragma config WDTE = SWDTEN     // WDT operating mode (WDT enabled/disabled by SEN bit, started by supervisor_init())
 
 //Required include statements for .h files
-#include <xc.h>
+#include "hal.h"
 #include <stdio.h>
 #include "dc_motor.h"
 #include "color.h"
 #include "lights.h"
 #include "serial.h"
 #include "interrupts.h"
+#include "timers.h"
+#include "trace.h"
+#include "record.h"
+#include "power.h"
+#include "supervisor.h"
+#include "mission.h"
+#include "motion.h"
+#include "gyro.h"
+#include "turncal.h"
+#include "perf.h"
 #include "string.h"
 
 
-#define _XTAL_FREQ 64000000 //note intrinsic _delay function is 62.5ns at 64,000,000Hz  
-#define turn90left 55 //Define the delay time for a 90 degree left turn
-#define turn90right 40 //Define the delay time for a 90 degree right turn
-#define turn180left 270 //Define the delay time for a 180 degree turn
-#define turn135right 120  //Define the delay time for a 135 degree right turn
-#define turn135left 120  //Define the delay time for a 135 degree left turn
-#define PWMcycle 199
 volatile unsigned int check = 0; // Interrupt flag to trigger color detection routine
+__persistent struct Memory path; // Path the buggy took, kept through a watchdog or fault reset for the safe return home
+
+/************************************
+ * Function returning the distance driven forwards since the start of a leg, for the path memory
+ * Inputs: Odometer reading at the start of the leg
+ * Outputs: Distance in ms at full speed, rounded to the nearest ms rather than cut off
+ * Functions called within: odometerRead()
+************************************/
+static int leg_distance(long start)
+{
+    long d = odometerRead() - start;
+    return (int)((d + ((d < 0) ? -50 : 50)) / 100);
+}
+
+/************************************
+ * Safe mode after a reset in the middle of a run, the colour click and the gyro on its bus are left off
+ * Inputs: Start mode from supervisor_init(), DC_motor structures and pointers for both motors
+ * Outputs: None, does not return
+ * Functions called within: retrace() from the kept path memory for SUP_RETURN with timed turns, as gyro_init()
+ * has not run since the reset, then the hazard lights
+ * and the serial trace and record commands until the buggy is switched off
+************************************/
+static void safe_mode(char mode, struct DC_motor *mL, struct DC_motor *mR)
+{
+    char command;
+    supervisor_require(SUP_SAFE);
+    sendStringSerial4(mode == SUP_RETURN ? "SAFE RETURN\n" : "SAFE STOP\n");
+    if(mode == SUP_RETURN){retrace(&path,mL,mR);} // Resumes a retrace that was interrupted
+    stop(mL,mR);
+    lights_play(LIGHT_TURN_L, 0b01, 2, 500, LIGHT_REPEAT); // Hazard lights
+    lights_play(LIGHT_TURN_R, 0b01, 2, 500, LIGHT_REPEAT);
+    while(1)
+    {
+        supervisor_checkin(SUP_SAFE);
+        if(isDataInRxBuf())
+        {
+            command = getCharFromRxBuf();
+            if(command == 'T'){trace_dump();} // Send the trace buffers
+            else if(command == 'R'){record_dump();} // Send the recorded colour reads
+            else if(command == 'J'){motion_report();} // Send the motion primitive timing
+        }
+        power_wait_ms(50);
+    }
+}
 
 void main(void){
-    color_click_init(); // Initialize color click 2
-    initDCmotorsPWM(PWMcycle); // Initialize PWM
+    power_init(); // Switch off the unused peripherals
+    initDCmotorsPWM(PWM_PERIOD); // Initialize PWM
     lights_init(); // Initialize LEDs on buggy
     initUSART4(); // Initialize USART
+    Timer0_init(); // Initialize the 1ms system tick
+    Timer1_init(); // Initialize the free running timer for latency measurements
     interrupts_master_init(); // Initialize the master device interrupts (clicker 2)
-    interrupts_slave_init(); // Initialize the slave device interrupts (color click)
+    char start = supervisor_init(&path); // Reset cause and watchdog, clears the path memory unless restarting mid run
+    if(start == SUP_NORMAL) // A faulty colour click is left off in safe mode
+    {
+        color_click_init(); // Initialize color click 2, the I2C waits need the interrupts to wake the core
+        interrupts_slave_init(); // Initialize the slave device interrupts (color click)
+        gyro_init(); // Closed loop turns if the gyro answers on the colour click I2C bus, timed turns otherwise
+    }
 
     //Declare two DC_motor structures 
     struct DC_motor motorL, motorR; 		
     //Left motor
     motorL.power=0; 						//zero power to start
     motorL.direction=0; 					//set default motor direction
-    motorL.dutyHighByte=(unsigned char *)(&PWM6DCH);	//store address of PWM duty high byte
-    motorL.dir_LAT=(unsigned char *)(&LATE); 		//store address of LAT in E
-    motorL.dir_pin=4; 						//pin RE4 controls direction for motorL
-    motorL.PWMperiod=PWMcycle;              //store PWMperiod for motor
+    motorL.dutyHighByte=(unsigned char *)(&HAL_MOTOR_L_DUTY);	//store address of PWM duty high byte
+    motorL.dir_LAT=(unsigned char *)(&HAL_MOTOR_L_DIR_LAT);		//store address of LAT in E
+    motorL.dir_pin=HAL_MOTOR_L_DIR_PIN; 						//pin RE4 controls direction for motorL
+    motorL.PWMperiod=PWM_PERIOD;              //store PWMperiod for motor
+    motorL.speed=0;                         //not moving
     //Right motor
     motorR.power=0;                         //zero power to start
     motorR.direction=0;                     //set default motor direction
-    motorR.dutyHighByte=(unsigned char *)(&PWM7DCH);    //store address of PWM duty high byte
-    motorR.dir_LAT=(unsigned char *)(&LATG);        //store address of LAT in C
-    motorR.dir_pin=6;                       // pin RC6 controls direction for motorR
-    motorR.PWMperiod=PWMcycle;              //store PWMperiod for motor
+    motorR.dutyHighByte=(unsigned char *)(&HAL_MOTOR_R_DUTY);    //store address of PWM duty high byte
+    motorR.dir_LAT=(unsigned char *)(&HAL_MOTOR_R_DIR_LAT);        //store address of LAT in C
+    motorR.dir_pin=HAL_MOTOR_R_DIR_PIN;                       // pin RC6 controls direction for motorR
+    motorR.PWMperiod=PWM_PERIOD;              //store PWMperiod for motor
+    motorR.speed=0;                         //not moving
+    motorCalLoad(&motorL,&motorR);          //trim curves of both motors, saved by motorCalibrate()
+    turncal_load();                         //turn times, saved by turncal_run()
+    motorSpeedLoad();                       //speed table, saved by turncal_speed()
+    if(start != SUP_NORMAL){safe_mode(start,&motorL,&motorR);} // Return home after a reset mid run
    
-    // Declare structure for the measured RGB values and the calibration values
+    // Declare structure for the measured RGB values, the black and white calibration at the clear threshold is in the robot profile
     struct RGB_val rgb;
-    // Assigning calibration values for black and white at clear threshold
-    rgb.W_R = 950;
-    rgb.W_G = 620;
-    rgb.W_B = 470;
-    rgb.B_R = 500;
-    rgb.B_G = 300;
-    rgb.B_B = 220;
- 
-    // Structure for the path memory
-    struct Memory m; //Structure to store the path that the buggy took
-    
-    //Clearing the path memory arrays
-    memset(m.time_forward, 0, sizeof(m.time_forward));
-    memset(m.turn, 0, sizeof(m.turn));
+    struct RGB_norm norm; // Calibrated values and hue of the read at a card
+    rgb.R = 0;
+    rgb.G = 0;
+    rgb.B = 0;
+    rgb.C = 0;
     
     //Initializing the debugging LED
-    LATHbits.LATH3 = 0;
-    TRISHbits.TRISH3 = 0;
+    HAL_GPIO_WRITE(PIN_DEBUG, 0);
     
-    char msg[40]; //Create msg array for sending serial output
-    int step=0; //Create a step vairable for incrementing the position in path memory arrays 
+    char msg[40]; //Create msg array for sending serial output (RGBC values, last card and forward count, the turns are sent from path memory)
+    char card = '-'; //Code of the card identified by classify_RGB()
+    char command; //Command received from the serial terminal
+    struct Color_stream stream; //Rolling classification of the colour samples taken while driving
+    char power = APPROACH_POWER; //Forward power chosen by the braking controller from the colour stream
+    long leg_start = odometerRead(); //Odometer reading at the start of the current leg
+    char hold = 0; //Set while an uploaded path waits for the X or H command, the buggy stands still
+    char i;
+    color_stream_reset(&stream);
+    perf_begin(); // Count the run from here, see perf.h
     
     while(1){
+        supervisor_checkin(SUP_LOOP);
         
-        LATDbits.LATD4 = 1;
-        //sprintf(msg,"%d %d %s \n",step,m.time_forward[step-1],m.turn); // Uncomment to only display Forward and Turns to send to realterm display
-        sprintf(msg,"%.02f %.02f %.02f %.02f %.02f %d %s\n",rgb.R,rgb.G,rgb.B,rgb.C,rgb.hue,m.time_forward[step-1],m.turn); // Combine RGBC values, Hue and Forward and Turns to send to realterm display
-        sendStringSerial4(msg); // Send RGB string reading to realterm
-        sendTxBuf(); // Interrupt flag to start transmit process
-        __delay_ms(5); // 1.53ms Execution time
-        LATDbits.LATD4 = 0;
+        TRACE_BEGIN(loop, TR_TELEMETRY);
+        if(!isDataInTxBuf()) // The last line has gone out, lines are skipped rather than waited for
+        {
+            sprintf(msg,"%u %u %u %u %c %d ",rgb.R,rgb.G,rgb.B,rgb.C,card,path.time_forward[path.step]); // Combine raw RGBC values, the last card and the Forward distance of this leg
+            TxBufferedString(msg); // Send RGB string reading to realterm, the whole line fits the TX buffer (robot profile)
+            TxBufferedString(path.turn); // Followed by the Turns
+            TxBufferedString("\n");
+            sendTxBuf(); // Interrupt flag to start transmit process
+        }
+        TRACE_END(loop, TR_TELEMETRY);
+        power_wait_ms(5); // The core idles until the next loop while the TX interrupt sends the line
         
-        fullSpeedAhead(&motorL,&motorR); // Move buggy forwards
-        m.time_forward[step] = m.time_forward[step] + 1; // Counter for time spent moving forwards
+        TRACE_BEGIN(loop, TR_STREAM);
+        if(!hold && color_stream(&rgb, &stream)) // New colour sample while driving
+        {
+            perf.samples++;
+            power = approachPower(&stream); // Decelerate early enough to reach approach power before the stand-off
+            if(color_stream_turn(&stream)){check = 1;} // Recognised card at the stand-off, no need to wait for the interrupt persistence
+        }
+        TRACE_END(loop, TR_STREAM);
         
-        if(check) // If the clear light threshold is exceeded (An obstacle is detected)
+        if(!hold)
         {
-            stop(&motorL,&motorR);  //Stopping the buggy
-            fullSpeedBack(&motorL,&motorR);     //Make buggy drive backwards
-            __delay_ms(30);                     //Drive backwards for this amount of time
-            color_read_RGB(&rgb);   // Update RGB values
-            calibrate_RGB(&rgb);    // Calibrate RGB values
-            RGB_to_Hue(&rgb);       // Convert RGB to hue
-            __delay_ms(30);
-
-            m.time_forward[step] =  m.time_forward[step] - 160; // Correcting for the time driven backwards
-            stop(&motorL,&motorR);  // Stopping the buggy
-            
-            if(rgb.max - rgb.min < 30) //if white or light blue is registered...
+            driveForward(&motorL,&motorR,power); // Move buggy forwards
+            path.time_forward[path.step] = leg_distance(leg_start); // Distance driven forwards in this leg, ms at full speed
+        }
+        
+        TRACE_BEGIN(loop, TR_SERVICE);
+        interrupts_service(); // Acknowledge the colour click and set check once the interrupt has settled
+        TRACE_END(loop, TR_SERVICE);
+        
+        if(isDataInRxBuf()) // Serial command from the terminal
+        {
+            command = getCharFromRxBuf();
+            if(command == 'T' || command == 'R') // Send the trace buffers or the recorded colour reads, standing still as the dump holds up the loop for seconds
             {
-                if(rgb.hue > 230 || rgb.hue < 150) // if white is registered...
-                {
-                retrace(&m,&motorL,&motorR,step);   //Retrace the path of the buggy
-                step = 0;                           //Set the step count to zero
-                stop(&motorL,&motorR);              //Stopping the buggy
-                __delay_ms(1000);
-                }else                               //if light blue is registered...
-                {
-                    turnLeft(&motorL,&motorR);     // Turn by 135 degrees to the right 
-                    __delay_ms(turn135left);
-                    stop(&motorL,&motorR);          //Stopping the buggy
-                    m.turn[step] = 'b';             //Add b to the turn memory array
-                }    
+                stop(&motorL,&motorR);
+                if(command == 'T'){trace_dump();}
+                else{record_dump();}
+                color_stream_reset(&stream); // The approach is measured again from standstill
+                power = APPROACH_POWER;
             }
-            else if(340<=rgb.hue && rgb.hue<=360)   //if pink/red/orange is registered...
+            else if(command == 'J'){motion_report();} // Send the motion primitive timing
+            else if(command == 'S'){perf_report();} // Send the performance record of the run
+            else if(command == 'M') // Guided motor calibration, best sent right after power up
             {
-                if(rgb.G > 60 && rgb.B > 60)        // If pink is registered...
-                {
-                    fullSpeedBack(&motorL,&motorR); //Make buggy drive backwards
-                    __delay_ms(1200);               //Drive backwards for this amount of time
-                    turnLeft(&motorL,&motorR);     //Turn by 90 degrees to the left
-                    __delay_ms(turn90left);
-                    stop(&motorL,&motorR);
-                    m.time_forward[step] = m.time_forward[step] - 110; //Cutting off the "dead end" from memory
-                    m.turn[step] = 'P';             //Add P to the turn memory array      
-                }
-                else if(rgb.R > 175 && rgb.G<75)    //if red is registered...
+                motorCalibrate(&motorL,&motorR);
+                leg_start = odometerRead(); // The test runs are not part of the path
+                perf_leg_start();
+            }
+            else if(command == 'C') // Turn calibration, the buggy faces a card close up with room to spin
+            {
+                turncal_run(&motorL,&motorR);
+                interrupts_flush(); //Drop colour click interrupts raised facing the card
+                color_stream_reset(&stream);
+                power = APPROACH_POWER;
+                leg_start = odometerRead(); // The spins are not part of the path
+                perf_leg_start();
+                check = 0;
+            }
+            else if(command == 'V') // Speed calibration, as the turn calibration
+            {
+                turncal_speed(&motorL,&motorR);
+                interrupts_flush(); //Drop colour click interrupts raised facing the card
+                color_stream_reset(&stream);
+                power = APPROACH_POWER;
+                leg_start = odometerRead(); // The spins are not part of the path
+                perf_leg_start();
+                check = 0;
+            }
+            else if(command == 'D'){mission_dump(&path);} // Send the path memory
+            else if(command == 'U') // Replace the path memory with an uploaded path, see mission.h
+            {
+                stop(&motorL,&motorR);
+                hold = mission_upload(&path); // Stand still until X or H, carry on exploring if the upload failed
+            }
+            else if(command == 'X' || command == 'H') // Drive the path memory from the start and back (X) or only back home (H)
+            {
+                stop(&motorL,&motorR);
+                if(command == 'X') // The mission is a run of its own
                 {
-                    turnRight(&motorL,&motorR);     // Turn by 90 degrees to the right
-                    __delay_ms(turn90right);
-                    stop(&motorL,&motorR);          //Stopping the buggy
-                    m.turn[step] = 'R';             //Add R to the turn memory array
-                }else //If orange is registered
-                { 
-                    turnRight(&motorL,&motorR);     // Turn by 135 degrees to the right
-                    __delay_ms(turn135right);
-                    stop(&motorL,&motorR);          //Stopping the buggy
-                    m.turn[step] = 'O';             //Add O to the turn memory array
+                    perf_begin();
+                    playback(&path,&motorL,&motorR);
                 }
+                perf_return(path.step);
+                retrace(&path,&motorL,&motorR);
+                stop(&motorL,&motorR);
+                perf_end();
+                perf_report(); // Send the performance record of the run
+                perf_begin(); // Exploring from here is the next run
+                path.step = 0; // Explore a new path from here
+                hold = 0;
+                interrupts_flush(); //Drop colour click interrupts raised on the way
+                color_stream_reset(&stream);
+                power = APPROACH_POWER;
+                leg_start = odometerRead();
+                check = 0;
             }
-            else if(120<=rgb.hue && rgb.hue<=160)   //If green is registered...
-            {
-                turnLeft(&motorL,&motorR);          // Turn by 90 degrees to the left
-                __delay_ms(turn90left);
-                stop(&motorL,&motorR);              //Stopping the buggy
-                m.turn[step] = 'G';                 //Add G to the turn memory array
-                
-            }   
-            else if(165<=rgb.hue && rgb.hue<=190)   //If blue is registered...
+        }
+        
+        if(check && !hold) // If the clear light threshold is exceeded (An obstacle is detected)
+        {
+            interrupts_check_serviced(); // Record the interrupt to service latency
+            perf_leg_end();
+            stop(&motorL,&motorR);  //Stopping the buggy
+            if(stream.card && stream.count >= COLOR_STREAM_AGREE) // Card already recognised while approaching, no need to back off and read again
             {
-                turnLeft(&motorL,&motorR);          // Turn by 180 degrees
-                __delay_ms(turn180left);
-                stop(&motorL,&motorR);              // Stopping the buggy
-                m.turn[step] = 'B';                 //Add B to the turn memory array
-                
+                card = stream.card;
+                perf_card(card, 0);
             }
-            else if(0<=rgb.hue && rgb.hue<=50)      // If yellow is registered...
+            else
             {
                 fullSpeedBack(&motorL,&motorR);     //Make buggy drive backwards
-                __delay_ms(1200); 
-                turnRight(&motorL,&motorR);         // Turn by 90 degrees to the right
-                __delay_ms(turn90right);
-                stop(&motorL,&motorR);              // Stopping the buggy
-                m.time_forward[step] = m.time_forward[step] - 110; //Cutting off the "dead end" from memory
-                m.turn[step] = 'Y';                 //Add Y to the turn memory array
+                power_wait_ms(BACKOFF_MS);             //Drive backwards for this amount of time
+#if COLOR_SPECTRAL
+                stop(&motorL,&motorR);  // Standing still for the four frames of the read, at the distance of the mixed read
+                TRACE_BEGIN(loop, TR_COLOR_READ);
+                color_read_spectral(&rgb); // Reflectance under each LED colour, ambient subtracted
+                RECORD_READ(&rgb, RECORD_SPECTRAL);
+                TRACE_END(loop, TR_COLOR_READ);
+                TRACE_BEGIN(loop, TR_CALIBRATE);
+                calibrate_spectral(&rgb, &norm);
+                TRACE_END(loop, TR_CALIBRATE);
+                TRACE_BEGIN(loop, TR_HUE);
+                RGB_to_Hue(&norm);      // Convert RGB to hue
+                TRACE_END(loop, TR_HUE);
+#else
+                TRACE_BEGIN(loop, TR_COLOR_READ);
+                color_read_RGB(&rgb);   // Update RGB values
+                RECORD_READ(&rgb, RECORD_CARD);
+                TRACE_END(loop, TR_COLOR_READ);
+                TRACE_BEGIN(loop, TR_CALIBRATE);
+                calibrate_RGB(&rgb, &norm); // Calibrate RGB values
+                TRACE_END(loop, TR_CALIBRATE);
+                TRACE_BEGIN(loop, TR_HUE);
+                RGB_to_Hue(&norm);      // Convert RGB to hue
+                TRACE_END(loop, TR_HUE);
+                power_wait_ms(BACKOFF_MS);
+                stop(&motorL,&motorR);  // Stopping the buggy
+#endif
+                
+                TRACE_BEGIN(loop, TR_CLASSIFY);
+                card = classify_RGB(&norm); // Identify the card from the calibrated RGB and hue values
+                RECORD_DECIDE(card);
+                TRACE_END(loop, TR_CLASSIFY);
+                perf_card(card, 1);
             }
-            else // If black is detected or unidentified colour, return back to starting position
+            supervisor_checkin(SUP_LOOP); // Stopped and read, the turn checks in on its own
+            HAL_PROBE(PROBE_CLASSIFY, card);
+            path.time_forward[path.step] = leg_distance(leg_start); // Distance up to the turn, including the stop and any backing off for the read
+            
+            switch(card)
             {
-                retrace(&m,&motorL,&motorR,step);   //Retrace the path of the buggy
-                step = 0;                           //Set the step count to zero
-                stop(&motorL,&motorR);              //Stopping the buggy
-                __delay_ms(1000);
+                case 'b':                           //if light blue is registered...
+                    turnLeft(&motorL,&motorR,135,turn_ms[TURN_L135]); // Turn by 135 degrees to the left
+                    stop(&motorL,&motorR);          //Stopping the buggy
+                    path.turn[path.step] = 'b';     //Add b to the turn memory array
+                    break;
+                case 'P':                           // If pink is registered...
+                    fullSpeedBack(&motorL,&motorR); //Make buggy drive backwards
+                    motion_run(&motorL,&motorR,MOTION_BACK,BACK_POWER,DEAD_END_MS); //Drive backwards for this amount of time
+                    turnLeft(&motorL,&motorR,90,turn_ms[TURN_L90]); //Turn by 90 degrees to the left
+                    stop(&motorL,&motorR);
+                    path.time_forward[path.step] = leg_distance(leg_start); //Cutting off the "dead end" driven back from memory
+                    path.turn[path.step] = 'P';     //Add P to the turn memory array      
+                    break;
+                case 'R':                           //if red is registered...
+                    turnRight(&motorL,&motorR,90,turn_ms[TURN_R90]); // Turn by 90 degrees to the right
+                    stop(&motorL,&motorR);          //Stopping the buggy
+                    path.turn[path.step] = 'R';     //Add R to the turn memory array
+                    break;
+                case 'O':                           //If orange is registered
+                    turnRight(&motorL,&motorR,135,turn_ms[TURN_R135]); // Turn by 135 degrees to the right
+                    stop(&motorL,&motorR);          //Stopping the buggy
+                    path.turn[path.step] = 'O';     //Add O to the turn memory array
+                    break;
+                case 'G':                           //If green is registered...
+                    turnLeft(&motorL,&motorR,90,turn_ms[TURN_L90]); // Turn by 90 degrees to the left
+                    stop(&motorL,&motorR);          //Stopping the buggy
+                    path.turn[path.step] = 'G';     //Add G to the turn memory array
+                    break;
+                case 'B':                           //If blue is registered...
+                    turnLeft(&motorL,&motorR,180,turn_ms[TURN_L180]); // Turn by 180 degrees
+                    stop(&motorL,&motorR);          // Stopping the buggy
+                    path.turn[path.step] = 'B';     //Add B to the turn memory array
+                    break;
+                case 'Y':                           // If yellow is registered...
+                    fullSpeedBack(&motorL,&motorR); //Make buggy drive backwards
+                    motion_run(&motorL,&motorR,MOTION_BACK,BACK_POWER,DEAD_END_MS);
+                    turnRight(&motorL,&motorR,90,turn_ms[TURN_R90]); // Turn by 90 degrees to the right
+                    stop(&motorL,&motorR);          // Stopping the buggy
+                    path.time_forward[path.step] = leg_distance(leg_start); //Cutting off the "dead end" driven back from memory
+                    path.turn[path.step] = 'Y';     //Add Y to the turn memory array
+                    break;
+                default: // If white (finish), black or an unidentified colour is detected, return back to starting position
+                    perf_return(path.step);
+                    retrace(&path,&motorL,&motorR);     //Retrace the path of the buggy
+                    path.step = 0;                      //Set the step count to zero
+                    stop(&motorL,&motorR);              //Stopping the buggy
+                    perf_end();
+                    interrupts_report();                //Send the interrupt latency statistics
+                    perf_report();                      //Send the performance record of the run
+                    for(i = 0; i < 4; i++)              //Stand still for a second
+                    {
+                        supervisor_checkin(SUP_LOOP);
+                        power_wait_ms(250);
+                    }
+                    perf_begin();                       //Exploring from here is the next run
+                    break;
             }
             
-            step = step + 1;   //Increment the step count for the memory arrays
+            path.step = path.step + 1;   //Increment the step count for the memory arrays
+            interrupts_flush(); //Drop colour click interrupts raised while the card was being handled
+            color_stream_reset(&stream); //Forget the card just handled
+            power = APPROACH_POWER; //Stay at approach power until the stream has measured the way ahead
+            leg_start = odometerRead(); //Start measuring the next leg
+            perf_leg_start();
             check = 0;         //Clear the check flag
         }
     }
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <string.h>
+#include "mission.h"
+#include "serial.h"
+#include "supervisor.h"
+
+/************************************
+ * Function to send the path memory over EUSART4
+ * Inputs: Path memory, sent up to the current step
+ * Outputs: None
+ * Functions called within: The serial function to send a string is called
+ * Output is one "P <leg> <turn>" line per step ended by "PE", which mission_upload() reads back.
+************************************/
+void mission_dump(struct Memory *m)
+{
+    char msg[MISSION_LINE];
+    int i;
+    for(i = 0; i <= m->step && i < PATH_STEPS; i++)
+    {
+        sprintf(msg,"P %d %c\n",m->time_forward[i],m->turn[i] ? m->turn[i] : MISSION_NO_TURN);
+        sendStringSerial4(msg);
+    }
+    sendStringSerial4("PE\n");
+}
+
+/************************************
+ * Function to read the leg and turn of a "P <leg> <turn>" line
+ * Inputs: Line, pointers for the leg and the turn
+ * Outputs: 1 if the line is a valid step
+ * Functions called within: None
+************************************/
+static char parse_step(char *line, int *leg, char *turn)
+{
+    long value = 0;
+    if(line[0] != 'P' || line[1] != ' ' || line[2] < '0' || line[2] > '9'){return 0;}
+    for(line += 2; *line >= '0' && *line <= '9'; line++)
+    {
+        value = value * 10 + (*line - '0');
+        if(value > 32767){return 0;}
+    }
+    if(line[0] != ' ' || line[2] != 0){return 0;}
+    if(line[1] != MISSION_NO_TURN && !strchr(PATH_TURNS, line[1])){return 0;}
+    *leg = (int)value;
+    *turn = (line[1] == MISSION_NO_TURN) ? 0 : line[1];
+    return 1;
+}
+
+/************************************
+ * Function to replace the path memory with a path or mission script received over EUSART4
+ * Inputs: Path memory
+ * Outputs: 1 when the upload was complete, 0 if a line was invalid, too many steps were sent or the
+ * sender stopped for SERIAL_LINE_TIMEOUT_MS; the path memory is then left empty
+ * Functions called within: The serial functions to send the "PR" ready reply, to read the lines and to send
+ * the "PU <steps>" or "PX <line>" reply
+************************************/
+char mission_upload(struct Memory *m)
+{
+    char line[MISSION_LINE];
+    char msg[12];
+    char turn;
+    int leg, len, n = 0;
+    unsigned char task = supervisor_require(SUP_SERIAL); // Checks in once per line
+    
+    memset(m, 0, sizeof(*m));
+    sendStringSerial4("PR\n"); // Ready, the sender waits for this as the RX buffer only holds RX_BUF_SIZE bytes
+    while((len = getLineFromRxBuf(line, sizeof(line))) >= 0)
+    {
+        supervisor_checkin(SUP_SERIAL);
+        if(len == 0){continue;} // End of the command line or a blank line
+        if(strcmp(line, "PE") == 0 && n > 0) // Complete
+        {
+            m->step = n - 1;
+            sprintf(msg,"PU %d\n",n);
+            sendStringSerial4(msg);
+            supervisor_require(task);
+            return 1;
+        }
+        if(n == PATH_STEPS || !parse_step(line, &leg, &turn)){break;}
+        m->time_forward[n] = leg;
+        m->turn[n] = turn;
+        n++;
+    }
+    memset(m, 0, sizeof(*m));
+    sprintf(msg,"PX %d\n",n + 1); // Line that was not accepted
+    sendStringSerial4(msg);
+    supervisor_require(task);
+    return 0;
+}
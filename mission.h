@@ -0,0 +1,22 @@
+#ifndef _mission_H
+#define _mission_H
+
+#include "hal.h"
+#include "dc_motor.h"
+
+/************************************
+ * Path memory transfer over EUSART4
+ * mission_dump() sends the path memory and mission_upload() replaces it with a path or mission script
+ * received in the same format, one "P <leg> <turn>" line per step ended by "PE": the leg in ms at full
+ * speed, then the turn code made at its end (PATH_TURNS) or MISSION_NO_TURN. An uploaded path can be
+ * driven from the start with playback() or followed home with retrace().
+************************************/
+
+#define MISSION_NO_TURN '-'     // Turn code of a step without a turn, e.g. the last leg
+#define MISSION_LINE    16      // Longest line of an upload, with the terminating 0
+
+//function prototypes (Function descriptions are to be found in the .c file)
+void mission_dump(struct Memory *m);
+char mission_upload(struct Memory *m);
+
+#endif
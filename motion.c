@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include "motion.h"
+#include "lights.h"
+#include "power.h"
+#include "supervisor.h"
+#include "serial.h"
+#include "timers.h"
+#include "gyro.h"
+#include "perf.h"
+
+struct Motion_log motion_log[MOTION_LOG_SIZE];  // Last MOTION_LOG_SIZE primitives
+static unsigned char motion_head = 0;           // Number of primitives logged, wraps at 256
+static unsigned char motion_n = 0;              // Number of primitives in the ring
+
+static struct DC_motor *motion_L, *motion_R;    // Motors of the primitive being run
+static volatile char motion_state = 0;          // 0 idle, 1 armed, 2 at power, 3 stop ramp
+static volatile unsigned int motion_ticks;      // Ticks left at power, or until the next ramp step
+static char motion_kind, motion_power;
+static unsigned int motion_request;             // ms requested at power
+static unsigned long motion_start;              // us stamp at which the power was applied
+
+/************************************
+ * Function returning a us stamp of the current tick, only called from LowISR
+ * Inputs: None
+ * Outputs: ms tick x 1000 plus the Timer0 count since it, the ISR entry latency
+ * Functions called within: None
+************************************/
+static unsigned long motion_stamp(void)
+{
+    return ms_ticks * 1000 + HAL_TMR0_COUNT() * 4;
+}
+
+/************************************
+ * Function to log a primitive in the ring, from LowISR or from motion_turn() while no primitive is armed
+ * Inputs: Primitive code, requested time or angle, jitter or angle missed
+ * Outputs: None
+ * Functions called within: None
+************************************/
+static void motion_log_add(char kind, unsigned int requested, int jitter)
+{
+    struct Motion_log *l = &motion_log[motion_head & (MOTION_LOG_SIZE - 1)];
+    l->kind = kind;
+    l->requested = requested;
+    l->jitter = jitter;
+    motion_head++;
+    if(motion_n < MOTION_LOG_SIZE){motion_n++;}
+}
+
+/************************************
+ * Function to run a motion primitive and wait in Idle mode until it has ramped down
+ * Inputs: DC_motor structure and pointer for the left motor and the right motor, primitive (MOTION_...),
+ * power out of 100 and the time at that power in ms
+ * Outputs: None
+ * Functions called within: stop() ends the previous motion first, as turnLeft() and turnRight() did. The
+ * primitive is then armed for motion_tick() and power_wait_ms() idles tick by tick until it has ended. The
+ * wait checks in with the supervisor only for as long as the primitive can take, one that does not end resets the PIC.
+************************************/
+void motion_run(struct DC_motor *mL, struct DC_motor *mR, char kind, char power, unsigned int ms)
+{
+    char turning = (kind == MOTION_LEFT || kind == MOTION_RIGHT);
+    unsigned char task;
+    unsigned long start;
+    if(turning && (mL->power || mR->power)){stop(mL,mR);}
+    if(kind == MOTION_LEFT){lights_play(LIGHT_TURN_L, 0b01, 2, INDICATOR_MS, LIGHT_REPEAT);} // Blink the indicator until the turn has stopped
+    if(kind == MOTION_RIGHT){lights_play(LIGHT_TURN_R, 0b01, 2, INDICATOR_MS, LIGHT_REPEAT);}
+    mL->direction = (kind == MOTION_LEFT || kind == MOTION_BACK);   // Direction high drives a wheel backwards
+    mR->direction = (kind == MOTION_RIGHT || kind == MOTION_BACK);
+    perf_phase(turning ? PERF_TURN : (kind == MOTION_BACK) ? PERF_BACK : PERF_FORWARD);
+    motion_L = mL;
+    motion_R = mR;
+    motion_kind = kind;
+    motion_power = power;
+    motion_ticks = ms;
+    motion_request = ms;
+    task = supervisor_require(SUP_MOTION);
+    start = get_ms();
+    motion_state = 1; // Armed, applied on the next tick
+    while(motion_state)
+    {
+        if(get_ms() - start <= (unsigned long)ms + 101 * RAMP_MS){supervisor_checkin(SUP_MOTION);} // Arming, time at power and the longest stop ramp
+        power_wait_ms(1);
+    }
+    supervisor_require(task);
+}
+
+/************************************
+ * Function to turn on the spot by an angle measured by the gyro, and wait until the buggy has settled
+ * Inputs: DC_motor structure and pointer for the left motor and the right motor, MOTION_LEFT or MOTION_RIGHT,
+ * angle in degrees and the time at full power of the timed turn for the same angle
+ * Outputs: None
+ * Functions called within: motion_run() turns for the time instead when there is no gyro (or GYRO_TURNS is 0).
+ * Otherwise stop() ends the previous motion and gyro_update() is sampled once per tick by power_wait_ms(),
+ * the power is set from the angle still to turn with setMotorPWM() until it is cut, then the gyro is followed
+ * until the buggy is at rest and the angle missed is logged.
+************************************/
+void motion_turn(struct DC_motor *mL, struct DC_motor *mR, char kind, int degrees, unsigned int ms)
+{
+    struct Gyro_yaw g;
+    float left, rate;   // Angle still to turn and rate towards it
+    char power = 100;
+    signed char sign = (kind == MOTION_LEFT) ? 1 : -1; // The gyro turns counterclockwise positive
+    unsigned long start;
+    unsigned char task;
+    
+    if(!GYRO_TURNS || !gyro_present())
+    {
+        motion_run(mL,mR,kind,100,ms);
+        return;
+    }
+    if(mL->power || mR->power){stop(mL,mR);}
+    task = supervisor_require(SUP_MOTION); // Both loops end on their timeouts
+    if(kind == MOTION_LEFT){lights_play(LIGHT_TURN_L, 0b01, 2, INDICATOR_MS, LIGHT_REPEAT);} // Blink the indicator until the turn has stopped
+    else{lights_play(LIGHT_TURN_R, 0b01, 2, INDICATOR_MS, LIGHT_REPEAT);}
+    mL->direction = (kind == MOTION_LEFT); // Direction high drives a wheel backwards
+    mR->direction = (kind == MOTION_RIGHT);
+    perf_phase(PERF_TURN);
+    gyro_zero(&g);
+    start = get_ms();
+    while(power)
+    {
+        supervisor_checkin(SUP_MOTION);
+        mL->power = power;
+        mR->power = power;
+        setMotorPWM(mL);
+        setMotorPWM(mR);
+        power_wait_ms(1);
+        gyro_update(&g);
+        left = degrees - sign * g.yaw;
+        rate = sign * g.rate;
+        if(left <= rate * GYRO_LEAD_MS / 1000 || get_ms() - start > MOTION_TURN_TIMEOUT_MS){power = 0;} // Coasts the rest
+        else if(left < GYRO_SLOW_DEG){power = GYRO_MIN_POWER + (char)((100 - GYRO_MIN_POWER) * left / GYRO_SLOW_DEG);}
+    }
+    mL->power = 0;
+    mR->power = 0;
+    setMotorPWM(mL);
+    setMotorPWM(mR);
+    lights_set(LIGHT_BRAKE, 1); // Brake light while coming to rest
+    start = get_ms();
+    do
+    {
+        supervisor_checkin(SUP_MOTION);
+        power_wait_ms(1);
+        gyro_update(&g);
+    } while((g.rate > MOTION_STILL_DPS || g.rate < -MOTION_STILL_DPS) && get_ms() - start < MOTION_SETTLE_MS);
+    lights_set(LIGHT_BRAKE, 0);
+    lights_set(LIGHT_TURN_L, 0);
+    lights_set(LIGHT_TURN_R, 0);
+    perf_phase(PERF_STAND);
+    motion_log_add(kind + MOTION_GYRO, degrees, (int)((sign * g.yaw - degrees) * 10));
+    supervisor_require(task);
+}
+
+/************************************
+ * Function to advance the motion primitive, called by the LowISR on every 1ms tick
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: setMotorPWMTick() applies the power and every step of the stop ramp, the
+ * achieved time is logged when the ramp starts
+************************************/
+void motion_tick(void)
+{
+    if(motion_state == 1) // Armed
+    {
+        motion_L->power = motion_power;
+        motion_R->power = motion_power;
+        setMotorPWMTick(motion_L);
+        setMotorPWMTick(motion_R);
+        motion_start = motion_stamp();
+        motion_state = 2;
+        if(motion_ticks){return;}
+    }
+    if(motion_state == 2) // At power
+    {
+        if(motion_ticks && --motion_ticks){return;}
+        motion_log_add(motion_kind, motion_request, (int)((long)(motion_stamp() - motion_start) - (long)motion_request * 1000));
+        lights_set(LIGHT_BRAKE, 1); // Brake light while slowing down
+        if(motion_kind == MOTION_FORWARD || motion_kind == MOTION_BACK){perf_phase(PERF_RAMP);} // The stop ramp of a turn counts as turning
+        motion_state = 3;
+        motion_ticks = 1; // First ramp step now
+    }
+    if(motion_state == 3 && !--motion_ticks) // Stop ramp, one power step every RAMP_MS as in stop()
+    {
+        if(motion_L->power){motion_L->power--;}
+        if(motion_R->power){motion_R->power--;}
+        setMotorPWMTick(motion_L);
+        setMotorPWMTick(motion_R);
+        motion_ticks = RAMP_MS;
+        if(!motion_L->power && !motion_R->power) // Stopped, as at the end of stop()
+        {
+            lights_set(LIGHT_BRAKE, 0);
+            lights_set(LIGHT_TURN_L, 0);
+            lights_set(LIGHT_TURN_R, 0);
+            perf_phase(PERF_STAND);
+            motion_state = 0;
+        }
+    }
+}
+
+/************************************
+ * Function to send the logged primitives and their jitter over EUSART4, oldest first
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: The serial function to send a string is called
+ * Output is one "MP <kind> <requested ms> <jitter us>" line per primitive, or "MP <kind> <degrees> <missed 0.1deg>"
+ * for a gyro turn, then "MJ <primitives> <mean jitter us> <worst jitter us>" over the absolute jitter of the
+ * timed primitives and "MG <turns> <mean missed 0.1deg> <worst missed 0.1deg>" over the gyro turns.
+************************************/
+void motion_report(void)
+{
+    char msg[48];
+    unsigned char head = motion_head;
+    unsigned char i, n = 0, turns = 0;
+    long jitter, sum = 0, worst = 0; // Absolute jitter in us
+    long missed, sum_missed = 0, worst_missed = 0; // Absolute angle missed in 0.1 degrees
+    struct Motion_log *l;
+    
+    for(i = head - motion_n; i != head; i++)
+    {
+        l = &motion_log[i & (MOTION_LOG_SIZE - 1)];
+        sprintf(msg,"MP %c %u %d\n",l->kind,l->requested,l->jitter);
+        sendStringSerial4(msg);
+        if(l->kind & MOTION_GYRO) // Lower case, a gyro turn
+        {
+            missed = (l->jitter < 0) ? -(long)l->jitter : l->jitter;
+            sum_missed += missed;
+            if(missed > worst_missed){worst_missed = missed;}
+            turns++;
+            continue;
+        }
+        jitter = (l->jitter < 0) ? -(long)l->jitter : l->jitter;
+        sum += jitter;
+        if(jitter > worst){worst = jitter;}
+        n++;
+    }
+    sprintf(msg,"MJ %u %ld %ld\n",n,n ? sum / n : 0,worst);
+    sendStringSerial4(msg);
+    sprintf(msg,"MG %u %ld %ld\n",turns,turns ? sum_missed / turns : 0,worst_missed);
+    sendStringSerial4(msg);
+}
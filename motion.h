@@ -0,0 +1,45 @@
+#ifndef _motion_H
+#define _motion_H
+
+#include "hal.h"
+#include "dc_motor.h"
+
+/************************************
+ * Motion primitives timed by the 1ms tick
+ * motion_run() arms a primitive, e.g. rotate left at full power for N ticks, and LowISR does the rest:
+ * the tick after arming applies the power, the tick N ticks later ends it and starts the stop ramp
+ * (RAMP_MS per power step, as stop()), so the time at power does not depend on what the main code is
+ * doing. The requested and achieved time of every primitive is kept in a ring of MOTION_LOG_SIZE
+ * (robot profile) for motion_report(), the achieved time is measured from the ISR entries to the 4us
+ * Timer0 count, so the jitter is the difference of the two.
+ * With a gyro on the bus (gyro.h) motion_turn() ends the turns on the integrated yaw instead: full power until
+ * GYRO_SLOW_DEG is left, then down to GYRO_MIN_POWER, cut GYRO_LEAD_MS ahead of the target. This runs in the
+ * main code, one gyro sample per tick, as the ISR must not wait on the I2C bus. The angle missed once the
+ * buggy has settled is logged in the same ring under the lower case code.
+************************************/
+
+// Primitives, the code is sent in the motion report
+#define MOTION_LEFT     'L' // Rotate left on the spot
+#define MOTION_RIGHT    'R' // Rotate right on the spot
+#define MOTION_FORWARD  'F' // Drive forwards
+#define MOTION_BACK     'B' // Drive backwards
+#define MOTION_GYRO     0x20 // Added to MOTION_LEFT or MOTION_RIGHT for a turn ended by the gyro, 'l' and 'r'
+
+#define MOTION_TURN_TIMEOUT_MS  2000    // Longest gyro turn, e.g. a wheel stuck against a wall
+#define MOTION_SETTLE_MS        300     // Longest wait for a gyro turn to come to rest
+#define MOTION_STILL_DPS        5       // Yaw rate taken as at rest
+
+struct Motion_log { //Requested and achieved time of one primitive, 5 bytes
+    char kind;                  // MOTION_...
+    unsigned int requested;     // ms at power
+    int jitter;                 // us at power achieved - requested, from applying the power to the start of the stop ramp,
+                                // for a gyro turn the requested time is the angle and this the angle missed in 0.1 degrees
+};
+
+//function prototypes (Function descriptions are to be found in the .c file)
+void motion_run(struct DC_motor *mL, struct DC_motor *mR, char kind, char power, unsigned int ms);
+void motion_turn(struct DC_motor *mL, struct DC_motor *mR, char kind, int degrees, unsigned int ms);
+void motion_tick(void);
+void motion_report(void);
+
+#endif
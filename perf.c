@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <string.h>
+#include "perf.h"
+#include "serial.h"
+#include "timers.h"
+
+struct Perf perf;                           // Counters of the current or last run
+static volatile char perf_current = PERF_STAND; // Phase the tick adds to
+static unsigned long leg_t0;                // ms at the start of the current leg
+static volatile char perf_running = 0;      // Set from perf_begin() to perf_end()
+
+/************************************
+ * Function to start counting a new run, the previous run is dropped
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void perf_begin(void)
+{
+    memset(&perf, 0, sizeof(perf));
+    perf.start = get_ms();
+    leg_t0 = perf.start;
+    perf_running = 1;
+}
+
+/************************************
+ * Function to mark the end of the outbound part of the run
+ * Inputs: Steps of the path memory to retrace
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void perf_return(unsigned char steps)
+{
+    perf.turn_back = get_ms();
+    perf.steps = steps;
+}
+
+/************************************
+ * Function to end the run at home, the counters are kept for perf_report() until perf_begin()
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void perf_end(void)
+{
+    perf.end = get_ms();
+    perf_running = 0;
+}
+
+/************************************
+ * Function to set the phase the run time is counted in
+ * Inputs: PERF_ phase
+ * Outputs: None
+ * Functions called within: None, a single byte write so it is also called from LowISR
+************************************/
+void perf_phase(char phase)
+{
+    perf_current = phase;
+}
+
+/************************************
+ * Function to count the run time, called by the LowISR on every 1ms tick
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void perf_tick(void)
+{
+    if(perf_running){perf.phase_ms[perf_current]++;}
+}
+
+/************************************
+ * Functions to time an outbound leg, from the end of a turn to the stop at the next card
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void perf_leg_start(void)
+{
+    leg_t0 = get_ms();
+}
+
+void perf_leg_end(void)
+{
+    if(perf.legs < PATH_STEPS){perf.leg_ms[perf.legs++] = (unsigned int)(get_ms() - leg_t0);}
+}
+
+/************************************
+ * Function to count a card decision
+ * Inputs: Card code, 1 if it was read standing after backing off, 0 if recognised by the stream
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void perf_card(char card, char read)
+{
+    const char *p = strchr(PERF_CARDS, card);
+    if(read){perf.reads++;}
+    else{perf.stream_cards++;}
+    perf.cards[(card && p) ? (unsigned char)(p - PERF_CARDS) : (unsigned char)(sizeof(PERF_CARDS) - 1)]++;
+}
+
+/************************************
+ * Function to send the run as one RS record over EUSART4, see perf.h
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: The serial function to send a string is called, the record is sent in parts
+ * and ends with the newline. The outbound and return times of a run still going are up to now, its phase
+ * times are copied with interrupts disabled as the tick adds to them.
+************************************/
+void perf_report(void)
+{
+    char msg[48];
+    unsigned long phase_ms[PERF_PHASES];
+    unsigned long now = perf_running ? get_ms() : perf.end;
+    unsigned long out = (perf.turn_back ? perf.turn_back : now) - perf.start;
+    unsigned char i;
+
+    HAL_INTERRUPTS(0);
+    memcpy(phase_ms, perf.phase_ms, sizeof(phase_ms));
+    HAL_INTERRUPTS(1);
+
+    sprintf(msg,"RS %lu %lu %u",out,perf.turn_back ? now - perf.turn_back : 0,perf.steps);
+    sendStringSerial4(msg);
+    for(i = 0; i < PERF_PHASES; i++)
+    {
+        sprintf(msg," %lu",phase_ms[i]);
+        sendStringSerial4(msg);
+    }
+    sprintf(msg," %u %u %u %u",perf.stops,perf.samples,perf.stream_cards,perf.reads);
+    sendStringSerial4(msg);
+    for(i = 0; i < sizeof(PERF_CARDS); i++)
+    {
+        sprintf(msg," %u",perf.cards[i]);
+        sendStringSerial4(msg);
+    }
+    sendStringSerial4(" L");
+    for(i = 0; i < perf.legs; i++)
+    {
+        sprintf(msg," %u",perf.leg_ms[i]);
+        sendStringSerial4(msg);
+    }
+    sendStringSerial4("\n");
+}
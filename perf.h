@@ -0,0 +1,58 @@
+#ifndef _perf_H
+#define _perf_H
+
+#include "hal.h"
+
+/************************************
+ * Per-run performance counters
+ * A run starts with perf_begin(), turns back with perf_return() and ends at home with perf_end(). While it runs
+ * the 1ms tick adds to the time of the current phase, set where the motors change (drive, ramp, turn, reverse
+ * or stand still), and the main code counts legs, stops, colour samples, reads and classifications.
+ * perf_report() sends the whole run as one RS record (below), at home and on the S command, so builds can be
+ * compared run by run from the serial log. The record is kept until the next run starts.
+ *   RS <outbound ms> <return ms> <steps> <forward ms> <ramp ms> <turn ms> <back ms> <stand ms> <stops>
+ *      <samples> <stream cards> <reads> <W> <b> <R> <G> <B> <Y> <P> <O> <K> <other> L <leg ms>...
+ * samples are the colour stream samples while driving, stream cards the cards recognised by the stream on the
+ * approach, reads the cards read again standing after backing off, followed by the card counts and the time
+ * of each outbound leg from the end of a turn to the stop at the next card.
+************************************/
+
+// Phases the run time is split into
+#define PERF_FORWARD    0   // Driving forwards at a steady power
+#define PERF_RAMP       1   // Ramping the forward power up or down
+#define PERF_TURN       2   // Turning on the spot, including the stop ramp of a turn
+#define PERF_BACK       3   // Reversing
+#define PERF_STAND      4   // Standing still, e.g. reading a card
+#define PERF_PHASES     5
+
+#define PERF_CARDS "WbRGBYPOK" // Card codes counted, anything else is other
+
+struct Perf { //Counters of one run
+    unsigned long start;                // ms at perf_begin()
+    unsigned long turn_back;            // ms at perf_return(), 0 while outbound
+    unsigned long end;                  // ms at perf_end(), 0 while running
+    unsigned long phase_ms[PERF_PHASES];// Time in each phase
+    unsigned int leg_ms[PATH_STEPS];    // Time of each outbound leg
+    unsigned char legs;                 // Outbound legs timed
+    unsigned char steps;                // Steps of the path memory when turning back
+    unsigned int stops;                 // stop() calls that stopped a moving buggy
+    unsigned int samples;               // Colour stream samples
+    unsigned char stream_cards;         // Cards recognised on the approach
+    unsigned char reads;                // Cards read again standing after backing off
+    unsigned char cards[sizeof(PERF_CARDS)]; // Classifications per card code, the last one other codes
+};
+
+extern struct Perf perf;
+
+//function prototypes (Function descriptions are to be found in the .c file)
+void perf_begin(void);
+void perf_return(unsigned char steps);
+void perf_end(void);
+void perf_phase(char phase);
+void perf_tick(void);
+void perf_leg_start(void);
+void perf_leg_end(void);
+void perf_card(char card, char read);
+void perf_report(void);
+
+#endif
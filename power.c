@@ -0,0 +1,68 @@
+#include "power.h"
+#include "timers.h"
+
+static unsigned long idle_t = 0; // Timer1 counts (0.5us) spent in Idle since power_init()
+
+/************************************
+ * Function to switch off the peripherals that are not used and select Idle for SLEEP
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void power_init(void)
+{
+    hal_power_init(); // Module disable bits of the unused peripherals, Idle instead of Sleep
+}
+
+/************************************
+ * Function to stop the core until the next enabled interrupt
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: None
+ * Called with interrupts disabled (HAL_INTERRUPTS(0)) once interrupts_master_init() has run, so the
+ * condition waited for cannot change between its check and SLEEP: the interrupt still wakes the core
+ * and is serviced once the caller enables interrupts again.
+************************************/
+void power_idle(void)
+{
+    unsigned int entry = HAL_TMR1_READ();
+    HAL_IDLE();                                 // Woken by the 1ms tick at the latest
+    idle_t += (HAL_TMR1_READ() - entry) & 0xFFFF; // Timer1 is 16 bit, also where int is wider
+}
+
+/************************************
+ * Function to wait for a number of ms in Idle mode, replaces __delay_ms() once the 1ms tick and
+ * the interrupts run
+ * Inputs: Time to wait in ms
+ * Outputs: None
+ * Functions called within: power_idle() until the tick has advanced by ms, the last fraction of a ms
+ * is spun on the Timer0 count so the wait is as exact as __delay_ms(), but ms need not be a constant.
+************************************/
+void power_wait_ms(unsigned int ms)
+{
+    unsigned long start;
+    unsigned char phase;
+    
+    HAL_INTERRUPTS(0);
+    start = ms_ticks;
+    phase = HAL_TMR0_COUNT();   // Position within the current ms, 4us counts
+    while(ms_ticks - start < ms)
+    {
+        power_idle();
+        HAL_INTERRUPTS(1);      // Let the interrupt that woke the core be serviced
+        HAL_INTERRUPTS(0);
+    }
+    HAL_INTERRUPTS(1);
+    while(get_ms() - start == ms && HAL_TMR0_COUNT() < phase); // Rest of the last ms
+}
+
+/************************************
+ * Function to read the time spent in Idle mode
+ * Inputs: None
+ * Outputs: ms in Idle since power_init()
+ * Functions called within: None
+************************************/
+unsigned long power_idle_ms(void)
+{
+    return idle_t / 2000; // Only changed by the main loop, no need to guard the read
+}
@@ -0,0 +1,20 @@
+#ifndef _power_H
+#define _power_H
+
+#include "hal.h"
+
+/************************************
+ * Low power waiting
+ * Waits that only depend on the 1ms tick, the colour click, EUSART4 or an I2C transfer put the core
+ * into Idle mode (CPU stopped, peripherals clocked) until the next interrupt instead of spinning
+ * in __delay_ms(). Peripherals the buggy does not use are switched off by power_init().
+ * The time spent in Idle is counted for the duty cycle reported with the trace dump.
+************************************/
+
+//function prototypes (Function descriptions are to be found in the .c file)
+void power_init(void);
+void power_idle(void);
+void power_wait_ms(unsigned int ms);
+unsigned long power_idle_ms(void);
+
+#endif
@@ -0,0 +1,69 @@
+# Robot profile of the competition buggy, see profiles/gen_config.py for the meaning and range of every key
+# Build another profile with PROFILE=name, e.g. make host-bench PROFILE=fast
+
+# Clock and PWM
+xtal_freq           64000000
+pwm_period          199
+
+# Motion, turn times hand tuned on the lab floor
+turn_l90_ms         65
+turn_r90_ms         50
+turn_l135_ms        130
+turn_r135_ms        130
+turn_l180_ms        280
+ramp_ms             5
+back_ramp_ms        10
+back_power          50
+backoff_ms          30
+dead_end_ms         1200
+approach_power      50
+cruise_power        50      # = approach_power until the speed table is measured, see profiles/fast.profile
+return_power        50
+brake_lead_ms       208     # two colour samples
+brake_ms_per_power  8
+speed_table         0 0 0 0 14 29 43 57 71 86 100    # model placeholder (simulator, linear above a 30% deadband), V measures the buggy
+
+# Gyro, closed loop turns when the gyro is on the bus, the turn times above otherwise
+gyro_turns          1
+gyro_slow_deg       30
+gyro_min_power      40
+gyro_lead_ms        10
+
+# Colour click
+color_atime         0xD5    # 104ms
+clear_threshold     1500
+approach_clear      700
+stream_clear        1300
+stream_agree        2
+int1_debounce_ms    10
+cal_white           950 620 470
+cal_black           500 300 220
+spectral_read       0       # one read under all three LEDs, see profiles/spectral.profile
+cal_spectral_white  760 496 376     # placeholder: cal_white x 0.8, the crosstalk of the simulator, not measured
+cal_spectral_black  400 240 176     # placeholder: cal_black x 0.8, measure both with spectral_read 1 on the buggy
+
+# Classification
+class_grey_spread       30
+class_white_hue_below   150
+class_white_hue_above   230
+class_red_hue           340
+class_pink_gb           60
+class_red_r             175
+class_red_g             75
+class_green_hue         120 160
+class_blue_hue          165 190
+class_yellow_hue        50
+
+# Buffers
+path_steps          50
+rx_buf_size         20
+tx_buf_size         88      # a whole telemetry line, path_steps + 35
+trace_loop_size     32
+trace_low_size      16
+trace_high_size     8
+record_size         32
+motion_log_size     16
+
+# Memory budget of the PIC18F67K40 (3562 bytes RAM, 128kB flash), checked from the linker map
+ram_limit           3072
+flash_limit         65536
@@ -0,0 +1,5 @@
+# Cruise and return above the approach power, for a buggy whose speed table was measured with V (turncal_speed())
+include default
+
+cruise_power        90
+return_power        90
@@ -0,0 +1,239 @@
+#!/usr/bin/env python3
+"""Generate robot_config.h, the compile-time configuration of the firmware, from a robot profile.
+
+A profile is a text file of "key value..." lines with '#' comments. "include name" reads
+profiles/name.profile first, so a variant only lists the keys it changes. Every key of the schema
+below must be set, unknown keys and values out of range are errors. The generated header also
+carries static asserts on the ranges and on the relations between keys, so a hand edited header
+fails to compile instead of producing a buggy that drives into walls.
+
+usage: gen_config.py profile_file [output_file]    (writes stdout without an output file)
+"""
+import math
+import os
+import sys
+
+# key, macro, minimum, maximum, number of values (0 for a scalar), comment
+SCHEMA = (
+    ("Clock and PWM",),
+    ("xtal_freq", "_XTAL_FREQ", 1000000, 64000000, 0, "Oscillator frequency for __delay_ms(), 62.5ns per instruction at 64MHz"),
+    ("pwm_period", "PWM_PERIOD", 1, 255, 0, "Timer2 period of the motor PWM"),
+    ("Motion",),
+    ("turn_l90_ms", "TURN_L90_MS", 1, 2000, 0, "Full power time of a 90 degree left turn"),
+    ("turn_r90_ms", "TURN_R90_MS", 1, 2000, 0, "Full power time of a 90 degree right turn"),
+    ("turn_l135_ms", "TURN_L135_MS", 1, 2000, 0, "Full power time of a 135 degree left turn"),
+    ("turn_r135_ms", "TURN_R135_MS", 1, 2000, 0, "Full power time of a 135 degree right turn"),
+    ("turn_l180_ms", "TURN_L180_MS", 1, 2000, 0, "Full power time of a 180 degree turn"),
+    ("ramp_ms", "RAMP_MS", 1, 50, 0, "Time per power step when driveForward() and stop() ramp the motors"),
+    ("back_ramp_ms", "BACK_RAMP_MS", 1, 50, 0, "Time per power step when fullSpeedBack() ramps up"),
+    ("back_power", "BACK_POWER", 30, 100, 0, "Reverse power of fullSpeedBack()"),
+    ("backoff_ms", "BACKOFF_MS", 0, 500, 0, "Reverse time before and after reading a card that was not recognised while approaching"),
+    ("dead_end_ms", "DEAD_END_MS", 0, 5000, 0, "Reverse time out of a pink or yellow dead end"),
+    ("approach_power", "APPROACH_POWER", 30, 100, 0, "Forward power near a card, leaves stopping room after the clear light interrupt"),
+    ("cruise_power", "CRUISE_POWER", 30, 100, 0, "Forward power while the colour stream sees nothing ahead"),
+    ("return_power", "RETURN_POWER", 30, 100, 0, "Forward power for the retrace legs, approach_power for the old return speed"),
+    ("brake_lead_ms", "BRAKE_LEAD_MS", 0, 2000, 0, "Time to the stand-off that is still left when approach power is reached"),
+    ("brake_ms_per_power", "BRAKE_MS_PER_POWER", 1, 100, 0, "Time to the stand-off allowed per power step above approach power, sets the deceleration"),
+    ("speed_table", "SPEED_TABLE", 0, 100, 11, "Wheel speed at 0, 10, ... 100% power in % of the speed at full power, until V saves a measured one"),
+    ("Gyro",),
+    ("gyro_turns", "GYRO_TURNS", 0, 1, 0, "1 to end the turns on the gyro angle when a gyro is found (gyro.h), 0 for timed turns"),
+    ("gyro_slow_deg", "GYRO_SLOW_DEG", 1, 180, 0, "Angle still to turn from which the turn power ramps down"),
+    ("gyro_min_power", "GYRO_MIN_POWER", 30, 100, 0, "Turn power at the end of the ramp down, must still turn the buggy"),
+    ("gyro_lead_ms", "GYRO_LEAD_MS", 0, 200, 0, "The power is cut this long before the target angle at the current rate, the buggy coasts the rest"),
+    ("Colour click",),
+    ("color_atime", "COLOR_ATIME", 0, 255, 0, "TCS3471 ATIME register, the integration time is (256 - ATIME) x 2.4ms"),
+    ("clear_threshold", "CLEAR_THRESHOLD", 1, 65535, 0, "Clear level raising the colour click interrupt, an obstacle is in front"),
+    ("approach_clear", "COLOR_APPROACH_C", 1, 65535, 0, "Clear level at which a card or wall is close enough to slow down for"),
+    ("stream_clear", "COLOR_STREAM_C", 1, 65535, 0, "Clear level from which a sample is close enough to the calibration distance to classify"),
+    ("stream_agree", "COLOR_STREAM_AGREE", 1, 10, 0, "Consecutive samples that must agree before a card is recognised"),
+    ("int1_debounce_ms", "INT1_DEBOUNCE_MS", 0, 100, 0, "Time the colour click line is left to settle before it is acknowledged"),
+    ("cal_white", "CAL_WHITE", 1, 65535, 3, "Raw R, G, B of the white card at the calibration distance"),
+    ("cal_black", "CAL_BLACK", 0, 65535, 3, "Raw R, G, B of the black card at the calibration distance"),
+    ("spectral_read", "COLOR_SPECTRAL", 0, 1, 0, "1 (experimental) to read a card under each LED colour in turn with the ambient frame subtracted, 0 for one read under all three"),
+    ("cal_spectral_white", "CAL_SPECTRAL_WHITE", 1, 65535, 3, "R under the red LED, G under the green and B under the blue, less ambient, of the white card (default.profile: simulator placeholder)"),
+    ("cal_spectral_black", "CAL_SPECTRAL_BLACK", 0, 65535, 3, "The same for the black card"),
+    ("Classification",),
+    ("class_grey_spread", "CLASS_GREY_SPREAD", 0, 255, 0, "RGB spread (max - min) below which a card is white or light blue"),
+    ("class_white_hue_below", "CLASS_WHITE_HUE_BELOW", 0, 360, 0, "Low spread cards with a hue below this are white"),
+    ("class_white_hue_above", "CLASS_WHITE_HUE_ABOVE", 0, 360, 0, "Low spread cards with a hue above this are white, light blue in between"),
+    ("class_red_hue", "CLASS_RED_HUE", 0, 360, 0, "Hue from which a card is pink, red or orange"),
+    ("class_pink_gb", "CLASS_PINK_GB", 0, 255, 0, "G and B above which a red hue card is pink"),
+    ("class_red_r", "CLASS_RED_R", 0, 255, 0, "R above which a red hue card is red (with G below class_red_g), orange otherwise"),
+    ("class_red_g", "CLASS_RED_G", 0, 255, 0, "G below which a red hue card is red"),
+    ("class_green_hue", "CLASS_GREEN_HUE", 0, 360, 2, "Hue range of green"),
+    ("class_blue_hue", "CLASS_BLUE_HUE", 0, 360, 2, "Hue range of blue"),
+    ("class_yellow_hue", "CLASS_YELLOW_HUE", 0, 360, 0, "Hue up to which a card is yellow"),
+    ("Buffers",),
+    ("path_steps", "PATH_STEPS", 2, 127, 0, "Steps of the path memory"),
+    ("rx_buf_size", "RX_BUF_SIZE", 2, 255, 0, "Serial receive buffer"),
+    ("tx_buf_size", "TX_BUF_SIZE", 2, 255, 0, "Serial transmit buffer"),
+    ("trace_loop_size", "TRACE_loop_SIZE", 1, 128, 0, "Trace ring of the main loop, a power of two"),
+    ("trace_low_size", "TRACE_low_SIZE", 1, 128, 0, "Trace ring of LowISR, a power of two"),
+    ("trace_high_size", "TRACE_high_SIZE", 1, 128, 0, "Trace ring of HighISR, a power of two"),
+    ("record_size", "RECORD_SIZE", 1, 128, 0, "Colour reads kept by the recorder, a power of two"),
+    ("motion_log_size", "MOTION_LOG_SIZE", 1, 128, 0, "Motion primitives kept for the jitter report, a power of two"),
+    ("Memory budget",),
+    ("ram_limit", "RAM_LIMIT", 1, 3562, 0, "Static RAM the build may use, the rest is left for the stack (host/mem_report.py)"),
+    ("flash_limit", "FLASH_LIMIT", 1, 131072, 0, "Program memory the build may use (host/mem_report.py)"),
+)
+
+# Relations between keys, checked here and by static asserts in the header
+RELATIONS = (
+    ("APPROACH_POWER <= CRUISE_POWER", "approach_power must not exceed cruise_power"),
+    ("APPROACH_POWER <= RETURN_POWER", "approach_power must not exceed return_power"),
+    ("COLOR_APPROACH_C < COLOR_STREAM_C", "approach_clear must be below stream_clear"),
+    ("COLOR_STREAM_C < CLEAR_THRESHOLD", "stream_clear must be below clear_threshold, cards are classified before the interrupt"),
+    ("CAL_WHITE_R > CAL_BLACK_R && CAL_WHITE_G > CAL_BLACK_G && CAL_WHITE_B > CAL_BLACK_B", "cal_white must be above cal_black"),
+    ("CAL_SPECTRAL_WHITE_R > CAL_SPECTRAL_BLACK_R && CAL_SPECTRAL_WHITE_G > CAL_SPECTRAL_BLACK_G && CAL_SPECTRAL_WHITE_B > CAL_SPECTRAL_BLACK_B",
+     "cal_spectral_white must be above cal_spectral_black"),
+    ("CLASS_WHITE_HUE_BELOW <= CLASS_WHITE_HUE_ABOVE", "class_white_hue_below must not exceed class_white_hue_above"),
+    ("CLASS_GREEN_HUE_LO <= CLASS_GREEN_HUE_HI", "class_green_hue must be low high"),
+    ("CLASS_BLUE_HUE_LO <= CLASS_BLUE_HUE_HI", "class_blue_hue must be low high"),
+    ("(TRACE_loop_SIZE & (TRACE_loop_SIZE - 1)) == 0", "trace_loop_size must be a power of two"),
+    ("(TRACE_low_SIZE & (TRACE_low_SIZE - 1)) == 0", "trace_low_size must be a power of two"),
+    ("(TRACE_high_SIZE & (TRACE_high_SIZE - 1)) == 0", "trace_high_size must be a power of two"),
+    ("(RECORD_SIZE & (RECORD_SIZE - 1)) == 0", "record_size must be a power of two"),
+    ("(MOTION_LOG_SIZE & (MOTION_LOG_SIZE - 1)) == 0", "motion_log_size must be a power of two"),
+    ("TX_BUF_SIZE > PATH_STEPS + 34", "tx_buf_size must hold a telemetry line, path_steps + 35 bytes"),
+)
+
+# Names of the values of short tables, tables without names are emitted as an initializer
+ELEMENTS = {"CAL_WHITE": ("R", "G", "B"), "CAL_BLACK": ("R", "G", "B"),
+            "CAL_SPECTRAL_WHITE": ("R", "G", "B"), "CAL_SPECTRAL_BLACK": ("R", "G", "B"),
+            "CLASS_GREEN_HUE": ("LO", "HI"), "CLASS_BLUE_HUE": ("LO", "HI")}
+
+
+def fail(msg):
+    sys.exit("gen_config: " + msg)
+
+
+def read_profile(path, values, seen=()):
+    if path in seen:
+        fail("%s includes itself" % path)
+    try:
+        f = open(path)
+    except OSError as e:
+        fail(str(e))
+    with f:
+        for n, line in enumerate(f, 1):
+            words = line.split("#", 1)[0].split()
+            if not words:
+                continue
+            if words[0] == "include" and len(words) == 2:
+                read_profile(os.path.join(os.path.dirname(path), words[1] + ".profile"), values, seen + (path,))
+                continue
+            try:
+                values[words[0]] = [int(w, 0) for w in words[1:]]
+            except ValueError:
+                fail("%s:%d: values must be integers" % (path, n))
+
+
+def motor_speed(table, power):
+    """Wheel speed at a power, interpolated from speed_table as motorSpeed() in dc_motor.c"""
+    i = power // 10
+    if i >= 10:
+        return table[10]
+    return table[i] + (table[i + 1] - table[i]) * (power - i * 10) // 10
+
+
+def check(values):
+    keys = [s[0] for s in SCHEMA if len(s) > 1]
+    for key in values:
+        if key not in keys:
+            fail("unknown key %s" % key)
+    macros = {}
+    for s in SCHEMA:
+        if len(s) == 1:
+            continue
+        key, macro, lo, hi, count, _ = s
+        if key not in values:
+            fail("%s is not set" % key)
+        v = values[key]
+        if len(v) != max(count, 1):
+            fail("%s needs %d value(s)" % (key, max(count, 1)))
+        for x in v:
+            if not lo <= x <= hi:
+                fail("%s = %d is outside %d..%d" % (key, x, lo, hi))
+        if macro in ELEMENTS:
+            for name, x in zip(ELEMENTS[macro], v):
+                macros[macro + "_" + name] = x
+        elif count == 0:
+            macros[macro] = v[0]
+    if any(a > b for a, b in zip(values["speed_table"], values["speed_table"][1:])):
+        fail("speed_table must not decrease")
+    for key in ("approach_power", "cruise_power", "return_power"): # Leg powers, the retrace divides by their speed
+        if motor_speed(values["speed_table"], values[key][0]) == 0:
+            fail("%s = %d is in the deadband of speed_table, it must give a wheel speed" % (key, values[key][0]))
+    for expr, msg in RELATIONS:
+        if not eval(expr.replace("&&", "and"), {}, macros):
+            fail(msg)
+
+
+def generate(path, values):
+    name = os.path.splitext(os.path.basename(path))[0]
+    out = ["#ifndef _robot_config_H",
+           "#define _robot_config_H",
+           "",
+           "/************************************",
+           " * Robot configuration generated by profiles/gen_config.py from " + os.path.basename(path) + ", do not edit.",
+           " * Change the profile instead, the Makefile regenerates this header.",
+           "************************************/",
+           "",
+           '#define ROBOT_PROFILE "%s"' % name,
+           "",
+           "#define CONFIG_ASSERT(cond, name) typedef char config_assert_##name[(cond) ? 1 : -1] // Static assert",
+           ]
+    asserts = []
+    for s in SCHEMA:
+        if len(s) == 1:
+            out += ["", "// " + s[0]]
+            continue
+        key, macro, lo, hi, count, comment = s
+        v = values[key]
+        if macro in ELEMENTS:
+            out.append("// " + comment)
+            for el, x in zip(ELEMENTS[macro], v):
+                out.append("#define %-24s %d" % (macro + "_" + el, x))
+                asserts.append(("%s_%s >= %d && %s_%s <= %d" % (macro, el, lo, macro, el, hi), "%s_%s" % (key, el.lower())))
+        elif count:
+            out.append("#define %-24s {%s} // %s" % (macro, ", ".join(str(x) for x in v), comment))
+        else:
+            out.append("#define %-24s %d // %s" % (macro, v[0], comment))
+            asserts.append(("%s >= %d && %s <= %d" % (macro, lo, macro, hi), key))
+    out += ["",
+            "// Derived values",
+            "#define %-24s %d // Integration time, (256 - COLOR_ATIME) x 2.4ms rounded up"
+            % ("COLOR_SAMPLE_MS", math.ceil((256 - values["color_atime"][0]) * 2.4)),
+            "#define %-24s %.4f // Colour stream range of the stand-off at which a recognised card is acted on, 1/sqrt(CLEAR_THRESHOLD)"
+            % ("COLOR_TURN_RANGE", 1 / math.sqrt(values["clear_threshold"][0])),
+            "#define %-24s %.4f // Colour stream range where classification starts, 1/sqrt(COLOR_STREAM_C)"
+            % ("BRAKE_TARGET_RANGE", 1 / math.sqrt(values["stream_clear"][0])),
+            "#define %-24s %.4f // Colour stream range of something close enough to slow down for, 1/sqrt(COLOR_APPROACH_C)"
+            % ("BRAKE_APPROACH_RANGE", 1 / math.sqrt(values["approach_clear"][0])),
+            "",
+            "// Ranges and relations"]
+    for cond, key in asserts:
+        out.append("CONFIG_ASSERT(%s, %s);" % (cond, key))
+    for n, (cond, _) in enumerate(RELATIONS):
+        out.append("CONFIG_ASSERT(%s, relation_%d);" % (cond, n))
+    out += ["", "#endif", ""]
+    return "\n".join(out)
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.exit(__doc__.strip().splitlines()[-1])
+    values = {}
+    read_profile(sys.argv[1], values)
+    check(values)
+    text = generate(sys.argv[1], values)
+    if len(sys.argv) == 2:
+        sys.stdout.write(text)
+        return
+    with open(sys.argv[2] + ".tmp", "w") as f: # Only replace a complete header
+        f.write(text)
+    os.replace(sys.argv[2] + ".tmp", sys.argv[2])
+
+
+if __name__ == "__main__":
+    main()
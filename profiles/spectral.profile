@@ -0,0 +1,5 @@
+# Experimental: read the cards that the colour stream did not recognise one LED colour at a time, with the ambient
+# light subtracted. The spectral calibration of the default profile is a placeholder derived from the simulator model.
+include default
+
+spectral_read       1
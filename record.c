@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include "record.h"
+#include "serial.h"
+#include "supervisor.h"
+
+#if RECORD_ENABLED
+struct Record_sample record_buf[RECORD_SIZE];   // Last RECORD_SIZE colour reads
+unsigned char record_head = 0;                  // Number of reads recorded, wraps at 256
+static unsigned char record_n = 0;              // Number of reads in the ring
+
+/************************************
+ * Function to record the raw values of a new colour read, call before calibrate_RGB() overwrites them
+ * Inputs: RGB_val structure and pointer rgb just filled by color_read_RGB(), where the read was taken
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void record_read(struct RGB_val *rgb, char source)
+{
+    struct Record_sample *s = &record_buf[record_head & (RECORD_SIZE - 1)];
+    s->c = rgb->C;
+    s->r = rgb->R;
+    s->g = rgb->G;
+    s->b = rgb->B;
+    s->source = source;
+    s->decision = RECORD_NONE;
+    record_head++;
+    if(record_n < RECORD_SIZE){record_n++;}
+    HAL_PROBE(PROBE_RECORD, source);
+}
+
+/************************************
+ * Function to record the card the last read was classified as
+ * Inputs: Card code returned by classify_RGB()
+ * Outputs: None
+ * Functions called within: None
+************************************/
+void record_decide(char card)
+{
+    record_buf[(unsigned char)(record_head - 1) & (RECORD_SIZE - 1)].decision = card;
+}
+
+/************************************
+ * Function to send the recorded reads over EUSART4, oldest first
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: The serial function to send a string is called, checking in with the supervisor per line
+ * Output is one "R<source> <decision> <C> <R> <G> <B>" line per read, ended by "RE". Appending the 
+ * card that was really in front of the sensor to each line makes a dataset for host/replay.c.
+************************************/
+void record_dump(void)
+{
+    char msg[32];
+    unsigned char head = record_head;
+    unsigned char i;
+    struct Record_sample *s;
+    unsigned char task = supervisor_require(SUP_SERIAL); // Longer than the watchdog period at 19200 baud
+    
+    for(i = head - record_n; i != head; i++)
+    {
+        supervisor_checkin(SUP_SERIAL);
+        s = &record_buf[i & (RECORD_SIZE - 1)];
+        sprintf(msg,"R%c %c %u %u %u %u\n",s->source,s->decision,s->c,s->r,s->g,s->b);
+        sendStringSerial4(msg);
+    }
+    sendStringSerial4("RE\n");
+    supervisor_require(task);
+}
+#else
+void record_dump(void)
+{
+    sendStringSerial4("RE\n"); // Compiled out, an empty dump
+}
+#endif
@@ -0,0 +1,47 @@
+#ifndef _record_H
+#define _record_H
+
+#include "hal.h"
+#include "color.h"
+
+/************************************
+ * Recorder of the colour reads, for reproducing misclassifications offline
+ * Every read keeps the raw RGBC counts, where it was taken and the card the firmware decided on
+ * in a RAM ring (RECORD_SIZE reads, set in the robot profile). record_dump() sends the ring over 
+ * EUSART4 for host/replay.c, which runs the classifier of any build over recorded datasets.
+ * Set RECORD_ENABLED to 0 to compile the recorder out.
+************************************/
+
+#ifndef RECORD_ENABLED
+#define RECORD_ENABLED 1
+#endif
+
+// Where a read was taken
+#define RECORD_STREAM   'S' // color_stream() sample while driving
+#define RECORD_CARD     'A' // read at the card after the clear light interrupt
+#define RECORD_SPECTRAL 'M' // color_read_spectral() read at the card, calibrated by calibrate_spectral()
+#define RECORD_NONE     '-' // Decision of a read that was not classified (too far away)
+
+struct Record_sample { //Recorded colour read, 10 bytes
+    unsigned int c, r, g, b;    // raw counts
+    char source;                // RECORD_STREAM, RECORD_CARD or RECORD_SPECTRAL
+    char decision;              // card code returned by classify_RGB(), RECORD_NONE if not classified
+};
+
+#if RECORD_ENABLED
+extern struct Record_sample record_buf[RECORD_SIZE];
+extern unsigned char record_head;
+
+#define RECORD_READ(rgb, source) record_read(rgb, source)
+#define RECORD_DECIDE(card) record_decide(card)
+#else
+#define RECORD_READ(rgb, source) ((void)0)
+#define RECORD_DECIDE(card) ((void)0)
+#endif
+
+//function prototypes (Function descriptions are to be found in the .c file)
+void record_read(struct RGB_val *rgb, char source);
+void record_decide(char card);
+void record_dump(void);
+
+#endif
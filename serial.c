@@ -1,5 +1,16 @@
-#include <xc.h>
 #include "serial.h"
+#include "timers.h"
+#include "power.h"
+#include "supervisor.h"
+
+//variables for a software RX/TX buffer
+volatile char EUSART4RXbuf[RX_BUF_SIZE];
+volatile char RxBufWriteCnt=0;
+volatile char RxBufReadCnt=0;
+
+volatile char EUSART4TXbuf[TX_BUF_SIZE];
+volatile char TxBufWriteCnt=0;
+volatile char TxBufReadCnt=0;
 
 /************************************************
 Function to initialise USART
@@ -8,41 +19,51 @@ Function to initialise USART
  * Functions called: None
  ***********************************************/
 void initUSART4(void) {
-    // Configure pins RC0 and RC1 to map to EUSART module
-    TRISCbits.TRISC1=1; 
-	RC0PPS = 0x12; // Map EUSART4 TX to RC0
-    RX4PPS = 0x11; // RX is RC1   
-    
-    // Set up EUSART to asyncronous baud rate 9600 using 8 bit baud rate generator value 
-    BAUD4CONbits.BRG16 = 0; 	//set baud rate scaling
-    TX4STAbits.BRGH = 0; 		//high baud rate select bit
-    SP4BRGL = 51; 			//set baud rate to 51 = 19200bps
-    SP4BRGH = 0;			//not used
-
-    RC4STAbits.CREN = 1; 		//enable continuos reception
-    TX4STAbits.TXEN = 1; 		//enable transmitter
-    RC4STAbits.SPEN = 1; 		//enable serial port
+    hal_uart_init(); // Map EUSART4 to RC0/RC1 at 19200bps and enable it
 }
 /************************************************
 Function to wait for a byte to arrive on serial port and read it once it does 
  * Inpute: None
- * Output: None
- * Functions called: None
+ * Output: The byte, 0 if none arrived within SERIAL_TIMEOUT_MS
+ * Functions called: power_idle() until the RX interrupt has put the byte in the RX buffer, interrupts are
+ * disabled between the check and SLEEP as in power_wait_ms()
  ***********************************************/
 char getCharSerial4(void) {
-	while (!PIR4bits.RC4IF);//wait for the data to arrive
-	return RC4REG; //return byte in RCREG
+    unsigned long start = get_ms();
+    char c = 0;
+    HAL_INTERRUPTS(0);
+    while (!isDataInRxBuf() && get_ms() - start <= SERIAL_TIMEOUT_MS){ //wait for the data to arrive
+        power_idle();
+        HAL_INTERRUPTS(1); // Let the interrupt that woke the core be serviced
+        HAL_INTERRUPTS(0);
+    }
+    HAL_INTERRUPTS(1);
+    if(isDataInRxBuf()){c = getCharFromRxBuf();}
+    return c;
 }
 
 /************************************************
-Function to check the TX reg is free and send a byte 
+Function to send a byte through the TX buffer, the TX interrupt sends it on
  * Inpute: None
- * Output: None
- * Functions called: None
+ * Output: None, the byte is dropped if the buffer has no room within SERIAL_TIMEOUT_MS
+ * Functions called: power_idle() while the buffer is full, the TX interrupt frees a byte every 0.52ms
+ * and wakes the core, then putCharToTxBuf() and sendTxBuf()
  ***********************************************/
 void sendCharSerial4(char charToSend) {
-    while (!PIR4bits.TX4IF); // wait for flag to be set
-    TX4REG = charToSend; //transfer char to transmitter
+    unsigned long start = get_ms();
+    HAL_INTERRUPTS(0);
+    while (isTxBufFull()){ // wait for room in the buffer
+        if(get_ms() - start > SERIAL_TIMEOUT_MS){ // Telemetry is not worth hanging the buggy for
+            HAL_INTERRUPTS(1);
+            return;
+        }
+        power_idle();
+        HAL_INTERRUPTS(1); // Let the TX interrupt take the next byte
+        HAL_INTERRUPTS(0);
+    }
+    putCharToTxBuf(charToSend);
+    HAL_INTERRUPTS(1);
+    sendTxBuf(); // Start the TX interrupt if it had run dry
 }
 
 /************************************************
@@ -91,6 +112,34 @@ char isDataInRxBuf (void){
     return (RxBufWriteCnt!=RxBufReadCnt);
 }
 
+/************************************************
+// Function to read a line from the RX buffer, waiting in Idle mode for its bytes
+ * Inpute: Buffer for the line and its size, '\r' is skipped and the '\n' is replaced by the terminating 0
+ * Output: Length of the line, -1 if no byte came for SERIAL_LINE_TIMEOUT_MS or the line is too long
+ * Functions called: power_wait_ms() to wait for the RX interrupt, checking in with the supervisor while it waits
+ ***********************************************/
+int getLineFromRxBuf(char *line, char size){
+    char c, n = 0;
+    int waited = 0, len = -1;
+    unsigned char task = supervisor_require(SUP_SERIAL); // Checks in up to SERIAL_LINE_TIMEOUT_MS per byte
+    while(1){
+        if(!isDataInRxBuf()){
+            if(waited++ >= SERIAL_LINE_TIMEOUT_MS){break;}
+            supervisor_checkin(SUP_SERIAL);
+            power_wait_ms(1);
+            continue;
+        }
+        waited = 0;
+        c = getCharFromRxBuf();
+        if(c == '\r'){continue;}
+        if(c == '\n'){line[n] = 0; len = n; break;}
+        if(n == size - 1){break;} // Too long for the buffer
+        line[n++] = c;
+    }
+    supervisor_require(task);
+    return len;
+}
+
 /************************************************
 // Function to retrieve a byte from the TX buffer
 // 1: there is data in the buffer
@@ -129,6 +178,20 @@ char isDataInTxBuf (void){
     return (TxBufWriteCnt!=TxBufReadCnt);
 }
 
+/************************************************
+// Function to check if the TX buffer is full
+// 1: the next byte would overwrite one not sent yet
+// 0: there is room
+ * Inpute: None
+ * Output: None
+ * Functions called: None
+ ***********************************************/
+char isTxBufFull (void){
+    unsigned char w = (TxBufWriteCnt >= TX_BUF_SIZE) ? 0 : TxBufWriteCnt; // Where the next byte goes
+    unsigned char r = (TxBufReadCnt >= TX_BUF_SIZE) ? 0 : TxBufReadCnt;   // Where the next byte is sent from
+    return ((w + 1 == TX_BUF_SIZE) ? 0 : w + 1) == r;
+}
+
 /************************************************
 // Function to add a string to the buffer
 // 1: there is data in the buffer
@@ -150,5 +213,5 @@ void TxBufferedString(char *string){
  * Functions called: None
  ***********************************************/
 void sendTxBuf(void){
-    if (isDataInTxBuf()) {PIE4bits.TX4IE=1;} //enable the TX interrupt to send data
+    if (isDataInTxBuf()) {HAL_UART_TX_INT(1);} //enable the TX interrupt to send data
 }
\ No newline at end of file
@@ -1,22 +1,22 @@
 #ifndef _SERIAL_H
 #define _SERIAL_H
 
-#include <xc.h>
+#include "hal.h"
 
-#define _XTAL_FREQ 64000000 //note intrinsic _delay function is 62.5ns at 64,000,000Hz  
 
-#define RX_BUF_SIZE 20
-#define TX_BUF_SIZE 60
+// RX_BUF_SIZE and TX_BUF_SIZE are set in the robot profile (robot_config.h)
+#define SERIAL_TIMEOUT_MS 5 // Longest wait for EUSART4 in the blocking functions, a byte takes 0.52ms
+#define SERIAL_LINE_TIMEOUT_MS 2000 // Longest wait for the next byte of a line in getLineFromRxBuf()
 
 //function prototype (Full function descriptions are to be found in the .c file)
 //variables for a software RX/TX buffer
-volatile char EUSART4RXbuf[RX_BUF_SIZE];
-volatile char RxBufWriteCnt=0;
-volatile char RxBufReadCnt=0;
+extern volatile char EUSART4RXbuf[RX_BUF_SIZE];
+extern volatile char RxBufWriteCnt;
+extern volatile char RxBufReadCnt;
 
-volatile char EUSART4TXbuf[TX_BUF_SIZE];
-volatile char TxBufWriteCnt=0;
-volatile char TxBufReadCnt=0;
+extern volatile char EUSART4TXbuf[TX_BUF_SIZE];
+extern volatile char TxBufWriteCnt;
+extern volatile char TxBufReadCnt;
 
 //basic EUSART funcitons
 void initUSART4(void);
@@ -28,11 +28,13 @@ void sendStringSerial4(char *string);
 char getCharFromRxBuf(void);
 void putCharToRxBuf(char byte);
 char isDataInRxBuf (void);
+int getLineFromRxBuf(char *line, char size);
 
 // circular Tx buffer functions (Ex3+)
 char getCharFromTxBuf(void);
 void putCharToTxBuf(char byte);
 char isDataInTxBuf (void);
+char isTxBufFull (void);
 void TxBufferedString(char *string); //Send buffered string with interrupts
 void sendTxBuf(void);
 
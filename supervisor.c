@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <string.h>
+#include "supervisor.h"
+#include "serial.h"
+
+__persistent struct Sup_state sup;              // Kept through resets, checked with SUP_MARKER
+static volatile unsigned char required = SUP_LOOP; // Tasks that must check in for the watchdog to be cleared
+static volatile unsigned char checked_in = 0;   // Tasks that checked in, cleared every window
+static unsigned char window_ms = 0;             // ms into the current window
+
+/************************************
+ * Function to check that the kept path memory can be retraced
+ * Inputs: Path memory
+ * Outputs: 1 if the step, the retrace state, the distances and the turn codes are in range
+ * Functions called within: None
+************************************/
+static char path_valid(struct Memory *m)
+{
+    int i;
+    if(m->step < 0 || m->step >= PATH_STEPS || m->retracing > RETRACE_LEG){return 0;}
+    for(i = 0; i <= m->step; i++)
+    {
+        if(m->time_forward[i] < 0){return 0;}
+        if(m->turn[i] && !strchr(PATH_TURNS, m->turn[i])){return 0;}
+    }
+    return 1;
+}
+
+/************************************
+ * Function to find why the PIC started, record it and start the watchdog
+ * Inputs: Path memory, cleared on a clean start
+ * Outputs: SUP_NORMAL, SUP_RETURN or SUP_STOPPED
+ * Functions called within: hal_reset_cause(), the EEPROM write function for the reset record and
+ * the serial function to send the "RST <cause> <fault> <task> <resets>" line
+ * Called once interrupts_master_init() has run, the watchdog is cleared from LowISR.
+************************************/
+char supervisor_init(struct Memory *m)
+{
+    char cause = hal_reset_cause();
+    char mode = SUP_NORMAL;
+    char msg[24];
+    
+    if(cause == RESET_POWER || cause == RESET_MCLR || sup.marker != SUP_MARKER) // Clean start
+    {
+        sup.marker = SUP_MARKER;
+        sup.task = 0;
+        sup.fault = SUP_FAULT_NONE;
+        sup.resets = 0;
+        memset(m, 0, sizeof(*m));
+    }
+    else // Watchdog, fault, brown-out or stack reset during a run
+    {
+        if(sup.resets < 255){sup.resets++;}
+        mode = (sup.resets <= SUP_MAX_RESETS && path_valid(m)) ? SUP_RETURN : SUP_STOPPED;
+        hal_eeprom_write(EE_SUPERVISOR, cause);
+        hal_eeprom_write(EE_SUPERVISOR + 1, sup.fault);
+        hal_eeprom_write(EE_SUPERVISOR + 2, sup.task);
+        hal_eeprom_write(EE_SUPERVISOR + 3, sup.resets);
+    }
+    sprintf(msg,"RST %c %c %u %u\n",cause,sup.fault,sup.task,sup.resets);
+    sendStringSerial4(msg);
+    sup.fault = SUP_FAULT_NONE;
+    HAL_WDT_START();
+    return mode;
+}
+
+/************************************
+ * Function to set the tasks that must check in, e.g. for a routine that blocks the main loop
+ * Inputs: SUP_ task bits, or the value returned by the earlier call when the routine returns
+ * Outputs: The tasks required before the call
+ * Functions called within: None
+************************************/
+unsigned char supervisor_require(unsigned char tasks)
+{
+    unsigned char previous = required;
+    required = tasks;
+    return previous;
+}
+
+/************************************
+ * Function for a task to show it is making progress, called from the task's own loop
+ * Inputs: Task checking in (SUP_ defines)
+ * Outputs: None
+ * Functions called within: None, the bit is set with a single instruction so the tick cannot lose it
+************************************/
+void supervisor_checkin(unsigned char task)
+{
+    checked_in |= task;
+    sup.task = task;
+}
+
+/************************************
+ * Function to clear the watchdog, called by LowISR every ms
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: None
+ * The watchdog is only cleared at the end of a SUP_WINDOW_MS window in which every required task checked
+ * in, so it resets the PIC when a task stops for about HAL_WDT_MS or the tick stops.
+************************************/
+void supervisor_tick(void)
+{
+    if(++window_ms < SUP_WINDOW_MS){return;}
+    window_ms = 0;
+    if((checked_in & required) == required){HAL_WDT_CLEAR();}
+    checked_in = 0;
+}
+
+/************************************
+ * Function to restart after a fault the firmware cannot recover from, e.g. a hung I2C bus
+ * Inputs: Fault (SUP_FAULT_ defines), reported after the restart
+ * Outputs: None, does not return
+ * Functions called within: None
+************************************/
+void supervisor_fault(char fault)
+{
+    sup.fault = fault;
+    HAL_RESET(); // Motors stop as the PWM is reset, the path memory is kept
+}
@@ -0,0 +1,55 @@
+#ifndef _supervisor_H
+#define _supervisor_H
+
+#include "hal.h"
+#include "dc_motor.h"
+
+/************************************
+ * Fault supervisor
+ * The watchdog is cleared from the 1ms tick only while every task required with supervisor_require()
+ * checks in from its own loop, so a hang in the main code or with interrupts disabled resets the PIC.
+ * A routine that blocks the main loop requires its own task until it returns, and checks in only for
+ * as long as it can take, so a wait that does not end stops feeding the watchdog. Hardware waits are bounded and call
+ * supervisor_fault() when they time out. The path memory and the supervisor state are __persistent:
+ * they keep their values through a watchdog or fault reset, so the restarted firmware can return home
+ * from where the buggy was (safe mode), with the colour click left off.
+************************************/
+
+// Tasks checking in with supervisor_checkin(), one bit each
+#define SUP_LOOP        0x01    // main loop pass
+#define SUP_SAFE        0x02    // safe mode, after the return home
+#define SUP_MOTION      0x04    // motion primitive, gyro turn or power ramp, for the time it can take
+#define SUP_PATH        0x08    // step of retrace() or playback()
+#define SUP_CAL         0x10    // calibration spin or run, operator wait up to its timeout
+#define SUP_SERIAL      0x20    // line of a dump, byte of an upload up to SERIAL_LINE_TIMEOUT_MS
+
+// Faults passed to supervisor_fault()
+#define SUP_FAULT_NONE  '-'
+#define SUP_FAULT_I2C   'I' // MSSP2 busy for longer than I2C_TIMEOUT_MS
+
+// Start modes returned by supervisor_init()
+#define SUP_NORMAL      0   // Power on or reset button, explore
+#define SUP_RETURN      1   // Reset in the middle of a run, return home from the kept path
+#define SUP_STOPPED     2   // Path lost or too many resets in a row, stay where the buggy is
+
+#define SUP_WINDOW_MS   250     // The watchdog is cleared after every window with a check in
+#define SUP_MAX_RESETS  3       // Resets after which the buggy no longer tries to return home
+#define SUP_MARKER      0xA55A  // Marks the kept state as valid, RAM is undefined after power on
+
+#define EE_SUPERVISOR   0x020   // Data EEPROM address of the last reset: cause, fault, task, reset count
+
+struct Sup_state { //Supervisor state kept through resets
+    unsigned int marker;    // SUP_MARKER once initialised
+    unsigned char task;     // Last task to check in, SUP_ bit of the one running when the buggy hung
+    char fault;             // Fault that caused the last software reset
+    unsigned char resets;   // Resets since the last clean start
+};
+
+//function prototypes (Function descriptions are to be found in the .c file)
+char supervisor_init(struct Memory *m);
+unsigned char supervisor_require(unsigned char tasks);
+void supervisor_checkin(unsigned char task);
+void supervisor_tick(void);
+void supervisor_fault(char fault);
+
+#endif
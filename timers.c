@@ -0,0 +1,55 @@
+#include "timers.h"
+
+volatile unsigned long ms_ticks = 0; // Milliseconds since Timer0 was started
+
+/************************************
+ * Function to initialise Timer0 as the 1ms system tick
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: None
+ * Timer0 runs in 8 bit mode with TMR0H as period register, Fosc/4 with a 1:64 prescaler
+ * gives 250kHz, so a period of 250 counts overflows every 1ms. The overflow is counted in LowISR.
+************************************/
+void Timer0_init(void)
+{
+    hal_timer0_init(); // 8 bit mode, 1:64 prescaler, period of 250 counts
+}
+
+/************************************
+ * Function to initialise Timer1 as a free running 16 bit counter for latency measurements
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: None
+ * Fosc/4 with a 1:8 prescaler gives 0.5us per count, overflowing every 32.7ms.
+************************************/
+void Timer1_init(void)
+{
+    hal_timer1_init(); // Fosc/4, 1:8 prescaler, 16 bit reads
+}
+
+/************************************
+ * Function to read the millisecond tick
+ * Inputs: None
+ * Outputs: Milliseconds since Timer0_init()
+ * Functions called within: None
+ * The 32 bit counter is updated by LowISR, so it is read until two reads agree.
+************************************/
+unsigned long get_ms(void)
+{
+    unsigned long t;
+    do {
+        t = ms_ticks;
+    } while(t != ms_ticks); // Re-read if the ISR updated the counter mid read
+    return t;
+}
+
+/************************************
+ * Function to read the free running Timer1 count
+ * Inputs: None
+ * Outputs: Timer1 count in 0.5us units
+ * Functions called within: None
+************************************/
+unsigned int get16bitTMR1val(void)
+{
+    return HAL_TMR1_READ();   // Reading the low byte latches the high byte
+}
@@ -0,0 +1,15 @@
+#ifndef _timers_H
+#define _timers_H
+
+#include "hal.h"
+
+
+extern volatile unsigned long ms_ticks; // 1ms system tick, incremented in LowISR
+
+//function prototypes (Function descriptions are to be found in the .c file)
+void Timer0_init(void);
+void Timer1_init(void);
+unsigned long get_ms(void);
+unsigned int get16bitTMR1val(void);
+
+#endif
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include "trace.h"
+#include "serial.h"
+#include "power.h"
+#include "supervisor.h"
+
+struct Trace_event trace_loop_buf[TRACE_loop_SIZE];    // Main loop events
+struct Trace_event trace_low_buf[TRACE_low_SIZE];      // LowISR events
+struct Trace_event trace_high_buf[TRACE_high_SIZE];    // HighISR events
+volatile unsigned char trace_loop_head = 0;            // Number of events written, wraps at 256
+volatile unsigned char trace_low_head = 0;
+volatile unsigned char trace_high_head = 0;
+volatile unsigned char trace_on = 1;                   // Recording enabled, paused while the rings are dumped
+
+/************************************
+ * Function to send the events of one ring, oldest first
+ * Inputs: Ring number for the output, buffer, ring size and head count at the start of the dump
+ * Outputs: None
+ * Functions called within: The serial function to send a string is called, checking in with the supervisor per line
+************************************/
+static void trace_dump_ring(unsigned char ring, struct Trace_event *buf, unsigned char size, unsigned char head)
+{
+    char msg[20];
+    unsigned char n = (head < size) ? head : size; // Only the last size events are kept
+    unsigned char i;
+    struct Trace_event e;
+    
+    for(i = head - n; i != head; i++)
+    {
+        supervisor_checkin(SUP_SERIAL);
+        e = buf[i & (size - 1)];
+        sprintf(msg,"T%u %02X %02X %04X\n",ring,e.id,e.ms,e.t);
+        sendStringSerial4(msg);
+    }
+}
+
+/************************************
+ * Function to send all trace rings over EUSART4
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: trace_dump_ring() for the main, LowISR and HighISR rings
+ * Output is one "T<ring> <id> <ms> <timer1>" line per event (hex) and the Idle duty cycle
+ * "TI <ms in Idle> <ms since start>" (decimal), ended by "TE", for host/trace_report.py. Recording is paused during the dump so the rings are not overwritten
+ * by the interrupts that fire while it is sent.
+************************************/
+void trace_dump(void)
+{
+    char msg[24];
+    unsigned char task = supervisor_require(SUP_SERIAL); // Longer than the watchdog period at 19200 baud
+    trace_on = 0;
+    trace_dump_ring(0, trace_loop_buf, TRACE_loop_SIZE, trace_loop_head);
+    trace_dump_ring(1, trace_low_buf, TRACE_low_SIZE, trace_low_head);
+    trace_dump_ring(2, trace_high_buf, TRACE_high_SIZE, trace_high_head);
+    sprintf(msg,"TI %lu %lu\n",power_idle_ms(),get_ms());
+    sendStringSerial4(msg);
+    sendStringSerial4("TE\n");
+    trace_on = 1;
+    supervisor_require(task);
+}
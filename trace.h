@@ -0,0 +1,64 @@
+#ifndef _trace_H
+#define _trace_H
+
+#include "hal.h"
+#include "timers.h"
+
+/************************************
+ * Hot path tracing into RAM ring buffers, dumped over EUSART4 with trace_dump()
+ * Every event stores its ID, the free running Timer1 count (0.5us) and the low byte of the 1ms tick,
+ * which the host tool (host/trace_report.py) uses to unwrap Timer1 into a single timeline.
+ * Each context (main loop, LowISR, HighISR) writes only its own ring, so recording needs no locking: 
+ * an interrupt always finishes its event before the code it interrupted continues.
+ * Set TRACE_ENABLED to 0 to compile all trace points out.
+************************************/
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+// Ring sizes TRACE_loop_SIZE, TRACE_low_SIZE and TRACE_high_SIZE (powers of two) are set in the robot profile
+
+#define TRACE_END_FLAG 0x80 // Set in the ID of end events
+
+// Event IDs
+#define TR_TELEMETRY    1   // sprintf and send of the telemetry line in main()
+#define TR_COLOR_READ   2   // color_read_RGB() or color_read_spectral()
+#define TR_CALIBRATE    3   // calibrate_RGB() or calibrate_spectral()
+#define TR_HUE          4   // RGB_to_Hue()
+#define TR_CLASSIFY     5   // classify_RGB()
+#define TR_SERVICE      6   // interrupts_service()
+#define TR_STREAM       7   // color_stream()
+#define TR_LOWISR       16  // LowISR()
+#define TR_HIGHISR      24  // HighISR()
+
+struct Trace_event { //Trace record, 4 bytes
+    unsigned char id;   // event ID, TRACE_END_FLAG set for end events
+    unsigned char ms;   // low byte of the 1ms tick
+    unsigned int t;     // Timer1 count
+};
+
+extern struct Trace_event trace_loop_buf[TRACE_loop_SIZE], trace_low_buf[TRACE_low_SIZE], trace_high_buf[TRACE_high_SIZE];
+extern volatile unsigned char trace_loop_head, trace_low_head, trace_high_head;
+extern volatile unsigned char trace_on;
+
+#if TRACE_ENABLED
+// ring: loop (main loop), low or high, the context the trace point runs in
+#define TRACE_PUT(ring, event) do { if(trace_on) { \
+        struct Trace_event *e_ = &trace_##ring##_buf[trace_##ring##_head & (TRACE_##ring##_SIZE - 1)]; \
+        e_->t = HAL_TMR1_READ(); \
+        e_->ms = (unsigned char)ms_ticks; \
+        e_->id = (event); \
+        trace_##ring##_head++; \
+    } } while(0)
+#else
+#define TRACE_PUT(ring, event) ((void)0)
+#endif
+
+#define TRACE_BEGIN(ring, id) TRACE_PUT(ring, id)
+#define TRACE_END(ring, id) TRACE_PUT(ring, (id) | TRACE_END_FLAG)
+
+//function prototypes (Function descriptions are to be found in the .c file)
+void trace_dump(void);
+
+#endif
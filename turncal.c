@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include "turncal.h"
+#include "color.h"
+#include "motion.h"
+#include "power.h"
+#include "serial.h"
+#include "supervisor.h"
+#include "timers.h"
+
+unsigned int turn_ms[TURN_TIMES]; // Loaded by turncal_load()
+
+static const int turn_degrees[TURN_TIMES] = {90, 90, 135, 135, 180};
+
+/************************************
+ * Function to load the turn time table from the data EEPROM
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: hal_eeprom_read(). Without a valid saved table (marker and checksum) the
+ * turn times of the robot profile are used.
+************************************/
+void turncal_load(void)
+{
+    unsigned char i, sum = 0;
+    for(i = 0; i < TURN_TIMES; i++)
+    {
+        turn_ms[i] = hal_eeprom_read(EE_TURN_CAL + 1 + 2*i) | (hal_eeprom_read(EE_TURN_CAL + 2 + 2*i) << 8);
+        sum = sum + (turn_ms[i] & 0xFF) + (turn_ms[i] >> 8);
+    }
+    if(hal_eeprom_read(EE_TURN_CAL) == TURN_CAL_MARKER && hal_eeprom_read(EE_TURN_CAL + 1 + 2*TURN_TIMES) == sum){return;}
+    turn_ms[TURN_L90] = TURN_L90_MS;
+    turn_ms[TURN_R90] = TURN_R90_MS;
+    turn_ms[TURN_L135] = TURN_L135_MS;
+    turn_ms[TURN_R135] = TURN_R135_MS;
+    turn_ms[TURN_L180] = TURN_L180_MS;
+}
+
+/************************************
+ * Function to save the turn time table to the data EEPROM
+ * Inputs: None
+ * Outputs: None
+ * Functions called within: hal_eeprom_write(), the marker is written last so an interrupted save is not loaded
+************************************/
+void turncal_save(void)
+{
+    unsigned char i, sum = 0;
+    hal_eeprom_write(EE_TURN_CAL, 0xFF);
+    for(i = 0; i < TURN_TIMES; i++)
+    {
+        hal_eeprom_write(EE_TURN_CAL + 1 + 2*i, turn_ms[i] & 0xFF);
+        hal_eeprom_write(EE_TURN_CAL + 2 + 2*i, turn_ms[i] >> 8);
+        sum = sum + (turn_ms[i] & 0xFF) + (turn_ms[i] >> 8);
+    }
+    hal_eeprom_write(EE_TURN_CAL + 1 + 2*TURN_TIMES, sum);
+    hal_eeprom_write(EE_TURN_CAL, TURN_CAL_MARKER);
+}
+
+/************************************
+ * Function to compare the share of the clear level of one channel with the reference card
+ * Inputs: Channel and clear count of the read, then of the reference
+ * Outputs: 1 if x/c is within TURNCAL_SHARE_PCT % of xr/cr
+ * Functions called within: None, compared cross multiplied as the counts are small at TURNCAL_ATIME
+************************************/
+static char turncal_share(unsigned int x, unsigned int c, unsigned int xr, unsigned int cr)
+{
+    long a = (long)x * cr, b = (long)xr * c;
+    long d = (a > b) ? a - b : b - a;
+    return d * 100 <= b * TURNCAL_SHARE_PCT;
+}
+
+/************************************
+ * Function to tell whether the colour click faces the reference card
+ * Inputs: RGB_val structure and pointer for the read and for the reference
+ * Outputs: 1 if the clear level is at least half the reference and the R, G and B shares match it
+ * Functions called within: turncal_share()
+************************************/
+static char turncal_facing(struct RGB_val *s, struct RGB_val *ref)
+{
+    if(s->C < ref->C / 2){return 0;}
+    return turncal_share(s->R, s->C, ref->R, ref->C) && turncal_share(s->G, s->C, ref->G, ref->C)
+        && turncal_share(s->B, s->C, ref->B, ref->C);
+}
+
+/************************************
+ * Function to time one revolution on the spot
+ * Inputs: DC_motor structure and pointer for the left motor and the right motor, MOTION_LEFT or MOTION_RIGHT,
+ * power out of 100, RGB_val structure and pointer for the reference card
+ * Outputs: ms per revolution, 0 if the buggy did not pass the card twice within TURNCAL_SPIN_MS
+ * Functions called within: setMotorPWM() spins the buggy, color_read_RGB() once per integration. A pass is
+ * centred between the read that first faces the card and the first that does not, the pass the buggy
+ * starts in is left out. stop() ends the spin.
+************************************/
+static unsigned int turncal_spin(struct DC_motor *mL, struct DC_motor *mR, char kind, char power, struct RGB_val *ref)
+{
+    struct RGB_val s;
+    unsigned long start = get_ms(), now, edge = 0, centre = 0; // Pass centres are kept doubled, in half ms
+    char facing = 1; // Until the first read, so a start in front of the card is not taken for a pass
+    char seen = 0; // A pass has started since the spin did
+    unsigned int rev = 0;
+
+    mL->direction = (kind == MOTION_LEFT); // Direction high drives a wheel backwards
+    mR->direction = (kind == MOTION_RIGHT);
+    mL->power = power;
+    mR->power = power;
+    setMotorPWM(mL);
+    setMotorPWM(mR);
+    while(!rev && get_ms() - start < TURNCAL_SPIN_MS)
+    {
+        supervisor_checkin(SUP_CAL);
+        power_wait_ms(TURNCAL_SAMPLE_MS);
+        color_read_RGB(&s);
+        now = get_ms();
+        if(turncal_facing(&s, ref) == facing){continue;}
+        facing = !facing;
+        if(facing) // Start of a pass
+        {
+            edge = now;
+            seen = 1;
+        }
+        else if(seen) // End of a pass
+        {
+            if(centre){rev = (unsigned int)((edge + now - centre) / 2);}
+            centre = edge + now;
+        }
+    }
+    stop(mL,mR);
+    return rev;
+}
+
+/************************************
+ * Function returning the yaw rate at a power, from the rates measured at the levels
+ * Inputs: Rates in degrees/s at power 100, 100 - TURNCAL_STEP, ..., power 1-100
+ * Outputs: Rate in degrees/s, interpolated between the two nearest levels, extrapolated from the two lowest
+ * below them down to 0 where the wheels stall
+ * Functions called within: None
+************************************/
+static float turncal_rate(float *rate, char power)
+{
+    char i = (100 - power) / TURNCAL_STEP;
+    float r;
+    if(i > TURNCAL_LEVELS - 2){i = TURNCAL_LEVELS - 2;}
+    r = rate[i + 1] + (rate[i] - rate[i + 1]) * (power - (100 - (i + 1) * TURNCAL_STEP)) / TURNCAL_STEP;
+    return (r > 0) ? r : 0;
+}
+
+/************************************
+ * Function to derive the time at full power of a turn
+ * Inputs: Rates of the levels as for turncal_rate(), angle in degrees
+ * Outputs: ms at full power, the stop ramp (one power step per RAMP_MS, see motion_tick()) turns the rest
+ * Functions called within: turncal_rate() for every step of the ramp
+************************************/
+static unsigned int turncal_time(float *rate, int degrees)
+{
+    float ramp = 0, ms;
+    char p;
+    for(p = 1; p < 100; p++){ramp += turncal_rate(rate, p);}
+    ramp = ramp * RAMP_MS / 1000; // Degrees turned while ramping down
+    ms = (degrees - ramp) * 1000 / rate[0];
+    if(ms < 1){return 1;}
+    if(ms > 2000){return 2000;}
+    return (unsigned int)(ms + 0.5);
+}
+
+/************************************
+ * Function to read the reference card at the short integration time of the spins
+ * Inputs: RGB_val structure and pointer for the reference
+ * Outputs: 1 if a card is in front of the colour click, else 0 with the integration time of the robot profile set back
+ * Functions called within: color_writetoaddr() for TURNCAL_ATIME, power_wait_ms() and color_read_RGB()
+************************************/
+static char turncal_reference(struct RGB_val *ref)
+{
+    color_writetoaddr(0x01, TURNCAL_ATIME);
+    power_wait_ms(3 * TURNCAL_SAMPLE_MS); // Reads at the old integration time are done
+    color_read_RGB(ref);
+    if(ref->C >= TURNCAL_MIN_C){return 1;}
+    color_writetoaddr(0x01, COLOR_ATIME);
+    return 0;
+}
+
+/************************************
+ * Turn calibration, started over the serial terminal with the buggy close in front of a reference card
+ * Inputs: DC_motor structure and pointer for the left motor and the right motor.
+ * Outputs: None
+ * Functions called within: turncal_reference() shortens the integration for the reference read and the
+ * spins, turncal_spin() at each level left then right, turncal_time() per turn and turncal_save(). The
+ * integration time of the robot profile is set back at the end.
+ * Output is "TC <L|R> <power> <ms per revolution>" per spin, 0 for a spin that stalled (the lower levels of
+ * that direction are skipped), then "TT <l90> <r90> <l135> <r135> <l180>" with the saved table. It takes
+ * about 45s, the buggy needs room to spin.
+************************************/
+void turncal_run(struct DC_motor *mL, struct DC_motor *mR)
+{
+    char msg[40];
+    struct RGB_val ref;
+    float rate[2][TURNCAL_LEVELS]; // degrees/s, left then right
+    unsigned int rev;
+    char d, i;
+    unsigned char task;
+
+    stop(mL,mR);
+    task = supervisor_require(SUP_CAL); // Each spin checks in up to TURNCAL_SPIN_MS
+    sendStringSerial4("Turn calibration: spinning in front of the reference card\n");
+    if(!turncal_reference(&ref))
+    {
+        sendStringSerial4("Turn calibration aborted, no card\n");
+        supervisor_require(task);
+        return;
+    }
+    for(d = 0; d < 2; d++)
+    {
+        rev = 1;
+        for(i = 0; i < TURNCAL_LEVELS; i++)
+        {
+            if(rev){rev = turncal_spin(mL,mR,d ? MOTION_RIGHT : MOTION_LEFT,100 - i * TURNCAL_STEP,&ref);} // Stalled above, stalls here too
+            rate[d][i] = rev ? 360000.0 / rev : 0;
+            sprintf(msg,"TC %c %d %u\n",d ? 'R' : 'L',100 - i * TURNCAL_STEP,rev);
+            sendStringSerial4(msg);
+        }
+    }
+    color_writetoaddr(0x01, COLOR_ATIME);
+    supervisor_require(task);
+    if(rate[0][0] == 0 || rate[1][0] == 0) // No revolution at full power
+    {
+        sendStringSerial4("Turn calibration aborted, keeping the saved turn times\n");
+        return;
+    }
+    for(i = 0; i < TURN_TIMES; i++){turn_ms[i] = turncal_time(rate[(i == TURN_R90 || i == TURN_R135) ? 1 : 0], turn_degrees[i]);}
+    turncal_save();
+    sprintf(msg,"TT %u %u %u %u %u\n",turn_ms[TURN_L90],turn_ms[TURN_R90],turn_ms[TURN_L135],turn_ms[TURN_R135],turn_ms[TURN_L180]);
+    sendStringSerial4(msg);
+}
+
+/************************************
+ * Speed calibration, started over the serial terminal with the buggy close in front of a reference card
+ * Inputs: DC_motor structure and pointer for the left motor and the right motor.
+ * Outputs: None
+ * Functions called within: turncal_reference(), turncal_spin() left at 100, 90, ... 10% power and
+ * motorSpeedSave(). On the spot both wheels turn at the same power, so the revolution time at full power
+ * over the one at a power is the wheel speed at that power in % of full speed, the speed table of
+ * motorSpeed(). The first level that stalls and those below are the deadband and are not spun.
+ * Output is "SC <power> <ms per revolution>" per spin, 0 for a stall, then "ST <speed at 0> ... <speed at 100>"
+ * with the saved table. It takes about a minute, the buggy needs room to spin.
+************************************/
+void turncal_speed(struct DC_motor *mL, struct DC_motor *mR)
+{
+    char msg[48];
+    struct RGB_val ref;
+    unsigned int rev[11];
+    unsigned char speed[11];
+    char i;
+    unsigned char task;
+
+    stop(mL,mR);
+    task = supervisor_require(SUP_CAL); // Each spin checks in up to TURNCAL_SPIN_MS
+    sendStringSerial4("Speed calibration: spinning in front of the reference card\n");
+    if(!turncal_reference(&ref))
+    {
+        sendStringSerial4("Speed calibration aborted, no card\n");
+        supervisor_require(task);
+        return;
+    }
+    rev[0] = 0;
+    for(i = 10; i > 0; i--)
+    {
+        rev[i] = (i == 10 || rev[i + 1]) ? turncal_spin(mL,mR,MOTION_LEFT,i * 10,&ref) : 0; // Stalled above, stalls here too
+        sprintf(msg,"SC %d %u\n",i * 10,rev[i]);
+        sendStringSerial4(msg);
+    }
+    color_writetoaddr(0x01, COLOR_ATIME);
+    supervisor_require(task);
+    if(!rev[10]) // No revolution at full power
+    {
+        sendStringSerial4("Speed calibration aborted, keeping the saved speed table\n");
+        return;
+    }
+    speed[10] = 100;
+    for(i = 10; i > 0; i--) // Not above the level over it, as motorSpeed() interpolates a table that does not decrease
+    {
+        speed[i - 1] = rev[i - 1] ? (unsigned char)((100UL * rev[10] + rev[i - 1] / 2) / rev[i - 1]) : 0;
+        if(speed[i - 1] > speed[i]){speed[i - 1] = speed[i];}
+    }
+    motorSpeedSave(speed);
+    sprintf(msg,"ST %u %u %u %u %u %u",speed[0],speed[1],speed[2],speed[3],speed[4],speed[5]);
+    sendStringSerial4(msg);
+    sprintf(msg," %u %u %u %u %u\n",speed[6],speed[7],speed[8],speed[9],speed[10]);
+    sendStringSerial4(msg);
+}
@@ -0,0 +1,46 @@
+#ifndef _turncal_H
+#define _turncal_H
+
+#include "hal.h"
+#include "dc_motor.h"
+
+/************************************
+ * Self-calibration of the timed turns
+ * The buggy stands close in front of a reference card (any colour) and spins on the spot, left then right, at
+ * each of TURNCAL_LEVELS powers. The colour click reads at a short integration time while it spins, and the
+ * buggy faces the card when the clear level is at least half the reference and the R, G and B shares of the
+ * clear match it; the centre of two such passes in a row is one revolution. The yaw rate at each power gives
+ * the turn time table: time at full power for the angle less what the stop ramp of motion_run() turns.
+ * The table is kept in the data EEPROM, an erased EEPROM gives the turn times of the robot profile.
+ * turncal_speed() spins the same way at every 10% of power for the speed table of dc_motor.c, the ratio of the
+ * revolution times being the ratio of the wheel speeds.
+************************************/
+
+// Turn time table, the index of each turn
+#define TURN_L90    0
+#define TURN_R90    1
+#define TURN_L135   2
+#define TURN_R135   3
+#define TURN_L180   4
+#define TURN_TIMES  5
+
+#define EE_TURN_CAL     0x030   // Data EEPROM address of the turn times: marker, 5 x 2 bytes low first, checksum
+#define TURN_CAL_MARKER 'T'     // Marks a saved table, erased EEPROM reads 0xFF
+
+#define TURNCAL_LEVELS      4       // Spin powers 100, 80, 60, 40
+#define TURNCAL_STEP        20      // Power between two levels
+#define TURNCAL_ATIME       0xFE    // 4.8ms integration, 2 cycles, so the clear count x 100 fits a long (ADC full scale 2048)
+#define TURNCAL_SAMPLE_MS   5       // One read per integration
+#define TURNCAL_MIN_C       20      // Clear level of the reference card at TURNCAL_ATIME below which there is no card
+#define TURNCAL_SHARE_PCT   20      // Tolerance of the R, G and B shares of the clear against the reference
+#define TURNCAL_SPIN_MS     15000   // Longest wait for two passes at one power, the wheels stall below it
+
+extern unsigned int turn_ms[TURN_TIMES]; // Time at full power of each turn, ms
+
+//function prototypes (Function descriptions are to be found in the .c file)
+void turncal_load(void);
+void turncal_save(void);
+void turncal_run(struct DC_motor *mL, struct DC_motor *mR);
+void turncal_speed(struct DC_motor *mL, struct DC_motor *mR);
+
+#endif